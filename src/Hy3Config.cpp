@@ -0,0 +1,139 @@
+#include <hyprland/src/config/ConfigManager.hpp>
+#include <hyprland/src/config/ConfigValue.hpp>
+
+#include "Hy3Config.hpp"
+#include "globals.hpp"
+#include "perf.hpp"
+
+using Hyprgraphics::CColor;
+
+Hy3TabColorSet Hy3TabColorSet::from(std::array<CHyprColor, Count> colors) {
+	Hy3TabColorSet set;
+
+	for (size_t i = 0; i < Count; i++) {
+		set.oklab[i] = colors[i].asOkLab();
+		set.alpha[i] = colors[i].a;
+	}
+
+	return set;
+}
+
+CHyprColor Hy3TabColorSet::merge(const std::array<float, Count>& weights) const {
+	CColor::SOkLab oklab {};
+	float alpha = 0;
+
+	for (size_t i = 0; i < Count; i++) {
+		oklab.l += weights[i] * this->oklab[i].l;
+		oklab.a += weights[i] * this->oklab[i].a;
+		oklab.b += weights[i] * this->oklab[i].b;
+		alpha += weights[i] * this->alpha[i];
+	}
+
+	// CColor converts the OkLab value back to rgb
+	return CHyprColor(CColor(oklab), alpha);
+}
+
+void Hy3Config::reload() {
+	// clang-format off
+	static const auto group_inset = CConfigValue<Config::INTEGER>("plugin:hy3:group_inset");
+	static const auto no_gaps_when_only = CConfigValue<Config::INTEGER>("plugin:hy3:no_gaps_when_only");
+	static const auto window_rounding = CConfigValue<Config::INTEGER>("decoration:rounding");
+	static const auto perf_stats = CConfigValue<Config::INTEGER>("plugin:hy3:debug:perf_stats");
+	static const auto check_invariants = CConfigValue<Config::INTEGER>("plugin:hy3:debug:check_invariants");
+
+	static const auto height = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:height");
+	static const auto padding = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:padding");
+	static const auto from_top = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:from_top");
+	static const auto radius = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:radius");
+	static const auto border_width = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:border_width");
+	static const auto opacity = CConfigValue<Config::FLOAT>("plugin:hy3:tabs:opacity");
+	static const auto blur = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:blur");
+	static const auto render_text = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:render_text");
+	static const auto text_center = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:text_center");
+	static const auto text_font = CConfigValue<Config::STRING>("plugin:hy3:tabs:text_font");
+	static const auto text_height = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:text_height");
+	static const auto text_padding = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:text_padding");
+	static const auto min_rerender_interval = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:text_min_rerender_interval");
+
+	static const auto col_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active");
+	static const auto col_border_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_border");
+	static const auto col_text_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_text");
+	static const auto col_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused");
+	static const auto col_border_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused_border");
+	static const auto col_text_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused_text");
+	static const auto col_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent");
+	static const auto col_border_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent_border");
+	static const auto col_text_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent_text");
+	static const auto col_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked");
+	static const auto col_border_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked_border");
+	static const auto col_text_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked_text");
+	static const auto col_active_alt_monitor = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_alt_monitor");
+	static const auto col_border_active_alt_monitor = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_alt_monitor_border");
+	static const auto col_text_active_alt_monitor = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_alt_monitor_text");
+	static const auto col_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive");
+	static const auto col_border_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive_border");
+	static const auto col_text_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive_text");
+	// clang-format on
+
+	Hy3Config config;
+
+	config.group_inset = *group_inset;
+	config.no_gaps_when_only = *no_gaps_when_only;
+	config.check_invariants = *check_invariants;
+	config.window_rounding = *window_rounding;
+
+	auto& tabs = config.tabs;
+	tabs.height = *height;
+	tabs.padding = *padding;
+	tabs.from_top = *from_top;
+	tabs.radius = *radius;
+	tabs.border_width = *border_width;
+	tabs.opacity = *opacity;
+	tabs.blur = *blur;
+	tabs.render_text = *render_text;
+	tabs.text_center = *text_center;
+	tabs.text_font = *text_font;
+	tabs.text_height = *text_height;
+	tabs.text_padding = *text_padding;
+	tabs.text_min_rerender_interval = *min_rerender_interval;
+
+	std::array<CHyprColor, Hy3TabColorSet::Count> fill = {
+	    CHyprColor(*col_active),
+	    CHyprColor(*col_focused),
+	    CHyprColor(*col_urgent),
+	    CHyprColor(*col_locked),
+	    CHyprColor(*col_active_alt_monitor),
+	    CHyprColor(*col_inactive),
+	};
+
+	std::array<CHyprColor, Hy3TabColorSet::Count> border = {
+	    CHyprColor(*col_border_active),
+	    CHyprColor(*col_border_focused),
+	    CHyprColor(*col_border_urgent),
+	    CHyprColor(*col_border_locked),
+	    CHyprColor(*col_border_active_alt_monitor),
+	    CHyprColor(*col_border_inactive),
+	};
+
+	tabs.fill = Hy3TabColorSet::from(fill);
+	tabs.border = Hy3TabColorSet::from(border);
+	tabs.text = Hy3TabColorSet::from({
+	    CHyprColor(*col_text_active),
+	    CHyprColor(*col_text_focused),
+	    CHyprColor(*col_text_urgent),
+	    CHyprColor(*col_text_locked),
+	    CHyprColor(*col_text_active_alt_monitor),
+	    CHyprColor(*col_text_inactive),
+	});
+
+	tabs.offset = (double) tabs.height + (double) tabs.padding;
+
+	if (tabs.blur && tabs.opacity >= 1.0) {
+		for (size_t i = 0; i < Hy3TabColorSet::Count; i++) {
+			if (fill[i].a < 1.0 || border[i].a < 1.0) tabs.needs_blur = true;
+		}
+	}
+
+	g_config = std::move(config);
+	Hy3Perf::enabled = *perf_stats;
+}
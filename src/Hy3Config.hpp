@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include <hyprgraphics/color/Color.hpp>
+#include <hyprland/src/helpers/Color.hpp>
+
+// A set of tab colors in OkLab, converted once on reload so merging them for every tab
+// on every frame does not repeat the conversion.
+struct Hy3TabColorSet {
+	enum Index {
+		Active,
+		Focused,
+		Urgent,
+		Locked,
+		ActiveAltMonitor,
+		Inactive,
+		Count,
+	};
+
+	std::array<Hyprgraphics::CColor::SOkLab, Count> oklab;
+	std::array<float, Count> alpha;
+
+	static Hy3TabColorSet from(std::array<CHyprColor, Count> colors);
+	// Weighted average of the set. Color is mixed in OkLab, alpha linearly.
+	CHyprColor merge(const std::array<float, Count>& weights) const;
+};
+
+// Snapshot of the config values read by the layout and render paths, rebuilt on every
+// config reload. Hot paths read g_config instead of dereferencing CConfigValue handles.
+struct Hy3Config {
+	int group_inset = 0;
+	bool no_gaps_when_only = false;
+	// decoration:rounding
+	int window_rounding = 0;
+	// debug:check_invariants
+	bool check_invariants = false;
+
+	struct {
+		int height = 0;
+		int padding = 0;
+		bool from_top = false;
+		int radius = 0;
+		int border_width = 0;
+		float opacity = 1.0;
+		bool blur = false;
+
+		bool render_text = false;
+		bool text_center = false;
+		std::string text_font;
+		int text_height = 0;
+		int text_padding = 0;
+		int text_min_rerender_interval = 0;
+
+		Hy3TabColorSet fill;
+		Hy3TabColorSet border;
+		Hy3TabColorSet text;
+
+		// space a tab group reserves above its children, height + padding
+		double offset = 0;
+		// blur is enabled and a fill or border color is translucent
+		bool needs_blur = false;
+	} tabs;
+
+	// Rebuild g_config from the current config values.
+	static void reload();
+};
@@ -1,7 +1,10 @@
 #include <cstdint>
+#include <expected>
 #include <regex>
 #include <optional>
 #include <set>
+#include <unordered_set>
+#include <utility>
 
 #include <dlfcn.h>
 #include <hyprland/src/Compositor.hpp>
@@ -28,7 +31,13 @@
 #include "log.hpp"
 #include "Hy3Layout.hpp"
 #include "Hy3Node.hpp"
+#include "Hy3Tree.hpp"
+#include "Hy3WindowNode.hpp"
 #include "TabGroup.hpp"
+#include "dispatchers.hpp"
+#include "geometry.hpp"
+#include "perf.hpp"
+#include "record.hpp"
 #include "globals.hpp"
 
 
@@ -75,71 +84,26 @@ std::string operationWorkspaceForName(const std::string& workspace) {
 	return workspace;
 }
 
-Hy3Node* findTabBarAt(Hy3Node& node, Vector2D pos, Hy3Node** focused_node);
-
-Hy3Layout::Hy3Layout() {
-	g_hy3Instances.insert(this);
-
-	m_windowActiveListener = Event::bus()->m_events.window.active.listen(
-	    [this](PHLWINDOW window, Desktop::eFocusReason) {
-		    if (!window) {
-					this->updateGroupBorderColors();
-			    return;
-				}
-
-		    auto* node = this->getNodeFromWindow(window.get());
-
-		    if (!node) {
-					this->updateGroupBorderColors();
-					return;
-				}
-
-		    this->onWindowFocusChange(window);
-	    }
-	);
-
-	m_mouseButtonListener = Event::bus()->m_events.input.mouse.button.listen(
-	    [this](IPointer::SButtonEvent event, Event::SCallbackInfo& info) {
-		    if (event.state != 1 || event.button != 272) return;
-
-		    auto ptr_surface_resource = g_pSeatManager->m_state.pointerFocus.lock();
-		    if (!ptr_surface_resource) return;
-
-		    auto ptr_surface = CWLSurface::fromResource(ptr_surface_resource);
-		    if (!ptr_surface) return;
-
-		    auto view = ptr_surface->view();
-		    auto* window = dynamic_cast<Desktop::View::CWindow*>(view.get());
-		    if (!window || window->m_isFloating || window->isFullscreen()) return;
-
-		    auto* node = this->getNodeFromWindow(window);
-		    if (!node) return;
-
-		    Hy3Node* focus = nullptr;
-		    auto mouse_pos = g_pInputManager->getMouseCoordsInternal();
-		    auto* tab_node = findTabBarAt(*this->root, mouse_pos, &focus);
-		    if (!tab_node) return;
-
-		    while (focus->is_group() && !focus->as_group().group_focused
-		           && focus->as_group().focused_child != nullptr)
-			    focus = focus->as_group().focused_child;
+Hy3Node* findTabBarAt(
+    Hy3Node& node,
+    Vector2D pos,
+    const Config::CCssGapData& gaps_in,
+    Hy3Node** focused_node
+);
 
-		    focus->focus(false, Desktop::FOCUS_REASON_CLICK);
-		    g_pInputManager->simulateMouseMovement();
-		    this->recalcGeometry();
-
-		    info.cancelled = true;
-	    }
-	);
-}
+Hy3Layout::Hy3Layout(): node_pool(Hy3NodePool::create()) { g_hy3Instances.insert(this); }
 
 Hy3Layout::~Hy3Layout() {
 	if (this->root) {
-		for (auto& window: this->root->windows()) {
-			window.setHidden(false);
+		for (auto& target: this->root->targets()) {
+			windowOf(target)->setHidden(false);
 		}
 	}
 	this->root.reset();
+	this->window_nodes.clear();
+	this->target_nodes.clear();
+	this->node_pool->release();
+	g_pendingGeometry.erase(this);
 
 	g_hy3Instances.erase(this);
 }
@@ -160,10 +124,16 @@ PHLMONITORREF Hy3Layout::monitor() {
 
 // ITiledAlgorithm overrides
 
+static int64_t recordedWorkspace(const SP<Layout::ITarget>& target) {
+	auto workspace = target ? target->workspace() : nullptr;
+	return workspace ? workspace->m_id : -1;
+}
+
 void Hy3Layout::newTarget(SP<Layout::ITarget> target) {
 	if (g_suppressInsert) return;
 	auto window = target->window();
 	if (!window) return;
+	Hy3RecordScope record(Hy3RecordEvent::NewTarget, window.get(), recordedWorkspace(target));
 	hy3_log(
 	    LOG,
 	    "newTarget called with window {:x} (monitor: {}, workspace: {})",
@@ -183,18 +153,71 @@ void Hy3Layout::newTarget(SP<Layout::ITarget> target) {
 		return;
 	}
 
-	auto node = Hy3Node::create(target);
+	auto node = Hy3WindowNode::create(*this->node_pool, target);
 
 	this->insertNode(std::move(node));
+	// new windows need their size before they are first configured
+	this->flushGeometry();
+}
+
+Hy3InsertPlan Hy3Layout::planInsert(std::optional<Vector2D> focalPoint) {
+	if (!this->root) return {};
+
+	// clang-format off
+	static const auto at_enable = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:enable");
+	static const auto at_ephemeral = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:ephemeral_groups");
+	static const auto at_trigger_width = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:trigger_width");
+	static const auto at_trigger_height = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:trigger_height");
+	// clang-format on
+
+	auto ws = this->workspace();
+	Hy3Node* at_point = nullptr;
+	std::optional<Hy3Point> focal_point;
+
+	if (focalPoint) {
+		focal_point = Hy3Point {focalPoint->x, focalPoint->y};
+
+		auto window_at_point = g_pCompositor->vectorToWindowUnified(
+		    *focalPoint,
+		    RESERVED_EXTENTS | INPUT_EXTENTS
+		);
+
+		if (window_at_point && window_at_point->m_workspace == ws) {
+			at_point = this->getNodeFromWindow(window_at_point.get());
+		}
+	}
+
+	this->updateAutotileWorkspaces();
+
+	Hy3AutotileParams autotile {
+	    .enable = *at_enable && this->shouldAutotileWorkspace(ws.get()),
+	    .ephemeral = *at_ephemeral != 0,
+	    .trigger_width = static_cast<int>(*at_trigger_width),
+	    .trigger_height = static_cast<int>(*at_trigger_height),
+	};
+
+	return ::planInsert(*this->root, at_point, focal_point, autotile);
+}
+
+Hy3GroupLayout Hy3Layout::firstGroupLayout() {
+	static const auto tab_first_window = CConfigValue<Config::INTEGER>("plugin:hy3:tab_first_window");
+	if (*tab_first_window) return Hy3GroupLayout::Tabbed;
+
+	auto wa_box = this->availableArea();
+	return wa_box.height > wa_box.width ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
 }
 
-void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoint) {
+void Hy3Layout::insertNode(std::unique_ptr<Hy3Node> node_up, std::optional<Vector2D> focalPoint) {
+	Hy3PerfScope perf(Hy3PerfOp::InsertNode);
+	// placement and autotiling read node sizes
+	this->flushGeometry();
+
 	if (node_up->parent != nullptr) {
 		hy3_log(
 		    ERR,
 		    "insertNode called for node {:x} which already has a parent ({:x})",
 		    (uintptr_t) node_up.get(),
-		    (uintptr_t) node_up->parent.get()
+		    (uintptr_t) node_up->parent
 		);
 		return;
 	}
@@ -210,155 +233,42 @@ void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoi
 		return;
 	}
 
-	node_up->size_ratio = 1.0;
-
-	auto& monitor = ws->m_monitor;
-
-	Hy3Node* opening_into;
-	Hy3Node* opening_after = nullptr;
-
-	auto* rootNode = this->getWorkspaceRootGroup(ws.get());
-
-	if (rootNode != nullptr) {
-		if (focalPoint) {
-			auto window_at_point = g_pCompositor->vectorToWindowUnified(
-			    *focalPoint,
-			    RESERVED_EXTENTS | INPUT_EXTENTS
-			);
-
-			if (window_at_point && window_at_point->m_workspace == ws) {
-				opening_after = this->getNodeFromWindow(window_at_point.get());
-			}
-		}
-
-		if (!opening_after) opening_after = &rootNode->getFocusedNode();
-		opening_after = &opening_after->getPlacementActor();
-
-		// opening_after->parent cannot be nullptr
-		if (opening_after == rootNode) {
-			opening_after->wrap(Hy3GroupLayout::SplitH, GroupEphemeralityOption::Standard);
-		}
-
-		opening_into = opening_after->parent.get();
-	} else {
-		static const auto tab_first_window =
-		    CConfigValue<Config::INTEGER>("plugin:hy3:tab_first_window");
-
-		// Use space work area if available, fall back to monitor
-		CBox wa_box(monitor->m_position, monitor->m_size);
-		auto algo = m_parent.lock();
-		if (algo) {
-			auto space = algo->space();
-			if (space) wa_box = space->workArea();
-		}
-
-		auto rootUp = makeUnique<Hy3RootNode>(this);
-		rootUp->self = WP<Hy3Node>(rootUp);
-		this->root = std::move(rootUp);
-
-		UP<Hy3Node> rootGroup;
-		if (*tab_first_window) {
-			rootGroup = Hy3Node::create(Hy3GroupLayout::Tabbed);
-		} else {
-			auto split_layout =
-					wa_box.height > wa_box.width ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
-			rootGroup = Hy3Node::create(split_layout);
-		}
-
-		opening_into = rootGroup.get();
-		this->root->as_group().insertChild(std::move(rootGroup));
-	}
-
-	if (opening_into->is_target()) {
-		hy3_log(ERR, "opening_into node ({:x}) was not a group node", (uintptr_t) opening_into);
-		errorNotif();
-		return;
-	}
-
-	{
-		// clang-format off
-		static const auto at_enable = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:enable");
-		static const auto at_ephemeral = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:ephemeral_groups");
-		static const auto at_trigger_width = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:trigger_width");
-		static const auto at_trigger_height = CConfigValue<Config::INTEGER>("plugin:hy3:autotile:trigger_height");
-		// clang-format on
-
-		this->updateAutotileWorkspaces();
-
-		auto& target_group = opening_into->as_group();
-		if (*at_enable && opening_after != nullptr && target_group.children.size() > 1
-		    && target_group.isSplit()
-		    && this->shouldAutotileWorkspace(ws.get()))
-		{
-			auto is_horizontal = target_group.layout == Hy3GroupLayout::SplitH;
-			auto trigger = is_horizontal ? *at_trigger_width : *at_trigger_height;
-			auto target_size = is_horizontal ? opening_into->visualBox.w : opening_into->visualBox.h;
-			auto size_after_addition = target_size / (target_group.children.size() + 1);
-
-			if (trigger >= 0 && (trigger == 0 || size_after_addition < trigger)) {
-				opening_after->wrap(
-				    is_horizontal ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH,
-				    *at_ephemeral ? GroupEphemeralityOption::Ephemeral : GroupEphemeralityOption::Standard
-				);
-				opening_into = opening_after->parent.get();
-			}
-		}
+	if (!this->root) {
+		this->root.reset(static_cast<Hy3GroupNode*>(
+		    Hy3WindowGroup::create(*this->node_pool, Hy3GroupLayout::Root).release()
+		));
+		this->root->tree_host = this;
 	}
 
-	// For mouse drops, determine if we should insert before or after the target node
-	if (focalPoint && opening_after) {
-		auto& parentGroup = opening_into->as_group();
-		bool insert_before = false;
+	auto plan = this->planInsert(focalPoint);
+	if (insertPlanned(*this->root, std::move(node_up), plan, this->firstGroupLayout()) == nullptr) return;
 
-		if (parentGroup.layout == Hy3GroupLayout::SplitH) {
-			insert_before = focalPoint->x < opening_after->visualBox.x + opening_after->visualBox.w * 0.5;
-		} else if (parentGroup.layout == Hy3GroupLayout::SplitV) {
-			insert_before = focalPoint->y < opening_after->visualBox.y + opening_after->visualBox.h * 0.5;
-		}
-
-		if (insert_before) {
-			auto iter = parentGroup.findChild(*opening_after);
-			if (iter != parentGroup.children.begin()) {
-				opening_after = std::prev(iter)->get();
-			} else {
-				opening_after = nullptr;
-			}
-		}
-	}
-
-	auto* node = node_up.get();
+	this->updateGroupBorderColors();
+}
 
-	{
-		auto& group = opening_into->as_group();
-		if (opening_after == nullptr) {
-			group.insertChild(group.children.begin(), std::move(node_up));
-		} else {
-			auto iter = group.findChild(*opening_after);
-			group.insertChild(std::next(iter), std::move(node_up));
-		}
+CBox Hy3Layout::availableArea() {
+	// Use space work area if available, fall back to monitor
+	auto ws = this->workspace();
+	CBox wa_box(ws->m_monitor->m_position, ws->m_monitor->m_size);
+	auto algo = m_parent.lock();
+	if (algo) {
+		auto space = algo->space();
+		if (space) wa_box = space->workArea();
 	}
 
-	hy3_log(
-	    LOG,
-	    "tiled node {:x} inserted {} node {:x} in node {:x}",
-	    (uintptr_t) node,
-	    opening_after ? "after" : "at beginning of",
-	    (uintptr_t) opening_after,
-	    (uintptr_t) opening_into
-	);
-
-	node->markFocused();
-	this->recalcGeometry();
-	this->updateGroupBorderColors();
+	return wa_box;
 }
 
 void Hy3Layout::movedTarget(SP<Layout::ITarget> target, std::optional<Vector2D> focalPoint) {
 	if (g_suppressInsert) return;
 
+	Hy3RecordScope record(Hy3RecordEvent::MovedTarget, target->window().get(), recordedWorkspace(target));
+	if (focalPoint) record.entry.point = std::make_pair(focalPoint->x, focalPoint->y);
+
 	// Use mouse position as focal point when none provided (e.g. DnD drop)
 	if (!focalPoint) focalPoint = g_pInputManager->getMouseCoordsInternal();
 
-	this->insertNode(Hy3Node::create(target), focalPoint);
+	this->insertNode(Hy3WindowNode::create(*this->node_pool, target), focalPoint);
 }
 
 void Hy3Layout::removeTarget(SP<Layout::ITarget> target) {
@@ -367,19 +277,20 @@ void Hy3Layout::removeTarget(SP<Layout::ITarget> target) {
 	auto* node = this->getNodeFromTarget(target);
 	if (node == nullptr) return;
 
-	auto window = node->as_window();
+	auto window = windowOf(*node);
+	Hy3RecordScope record(Hy3RecordEvent::RemoveTarget, window.get(), recordedWorkspace(target));
 
 	hy3_log(
 	    LOG,
 	    "removing target (window {:x} as node {:x}) from node {:x}",
 	    (uintptr_t) window.get(),
 	    (uintptr_t) node,
-	    (uintptr_t) node->parent.get()
+	    (uintptr_t) node->parent
 	);
 
 	window->m_ruleApplicator->resetProps(Desktop::Rule::RULE_PROP_ALL, Desktop::Types::PRIORITY_LAYOUT);
 
-	auto* parent_node = node->parent.get();
+	auto* parent_node = node->parent;
 	// Extracted UP drops — node is destroyed.
 	parent_node->extractAndMerge(*node, nullptr, CollapsePolicy::InvalidOnly);
 	this->recalcGeometry();
@@ -387,9 +298,73 @@ void Hy3Layout::removeTarget(SP<Layout::ITarget> target) {
 	this->updateGroupBorderColors();
 }
 
+void Hy3Layout::onWindowActive(PHLWINDOW window) {
+	Hy3RecordScope record(
+	    Hy3RecordEvent::FocusChange,
+	    window.get(),
+	    window && window->m_workspace ? window->m_workspace->m_id : -1
+	);
+
+	auto* owner = window ? hy3InstanceForWorkspace(window->m_workspace) : nullptr;
+
+	for (auto* hy3: g_hy3Instances) {
+		if (hy3 == owner) continue;
+
+		// without a focused window any layout may draw its focused group as selected,
+		// otherwise only layouts that currently do so need to clear it
+		if (!window || !hy3->selected_windows.empty()) hy3->updateGroupBorderColors();
+	}
+
+	if (owner) owner->onWindowFocusChange(window);
+}
+
+void Hy3Layout::onMouseButton(IPointer::SButtonEvent event, Event::SCallbackInfo& info) {
+	if (event.state != 1 || event.button != 272) return;
+
+	auto ptr_surface_resource = g_pSeatManager->m_state.pointerFocus.lock();
+	if (!ptr_surface_resource) return;
+
+	auto ptr_surface = CWLSurface::fromResource(ptr_surface_resource);
+	if (!ptr_surface) return;
+
+	auto view = ptr_surface->view();
+	auto* window = dynamic_cast<Desktop::View::CWindow*>(view.get());
+	if (!window || window->m_isFloating || window->isFullscreen()) return;
+
+	auto* hy3 = hy3InstanceForWorkspace(window->m_workspace);
+	if (!hy3 || !hy3->getNodeFromWindow(window)) return;
+
+	if (hy3->focusTabAtCursor()) info.cancelled = true;
+}
+
+bool Hy3Layout::focusTabAtCursor() {
+	this->flushGeometry();
+
+	Hy3Node* focus = nullptr;
+	auto mouse_pos = g_pInputManager->getMouseCoordsInternal();
+	auto* tab_node = findTabBarAt(*this->root, mouse_pos, this->gapsIn(), &focus);
+	if (!tab_node) return false;
+
+	while (focus->is_group() && !focus->as_group().group_focused
+	       && focus->as_group().focused_child != nullptr)
+		focus = focus->as_group().focused_child;
+
+	focusNode(*focus, false, Desktop::FOCUS_REASON_CLICK);
+	g_pInputManager->simulateMouseMovement();
+
+	return true;
+}
+
 void Hy3Layout::onWindowFocusChange(PHLWINDOW window) {
 	auto* node = this->getNodeFromWindow(window.get());
-	if (node == nullptr) return;
+
+	if (node == nullptr) {
+		this->updateGroupBorderColors();
+		return;
+	}
+
+	// focusing a window clears its urgency
+	node->invalidateAggregates();
 
 	hy3_log(
 	    TRACE,
@@ -399,30 +374,96 @@ void Hy3Layout::onWindowFocusChange(PHLWINDOW window) {
 	);
 
 	node->markFocused();
-	this->recalcGeometry();
 
 	this->updateGroupBorderColors();
 }
 
 void Hy3Layout::updateGroupBorderColors() {
 	if (!this->root) return;
+
+	if (Hy3Batch::active()) {
+		this->batch_pending.border_colors = true;
+		return;
+	}
+
 	static auto active_color = CConfigValue<Config::IComplexConfigValue>("general:col.active_border");
 	auto* const active_color_data = sc<Config::CGradientValueData*>(active_color.ptr());
 
-	for (auto& w: this->root->windows()) {
-		if (this->shouldRenderSelected(&w)) {
-			w.m_ruleApplicator->inactiveBorderColor().set(*active_color_data, Desktop::Types::PRIORITY_LAYOUT);
-		} else {
-			w.m_ruleApplicator->inactiveBorderColor().unset(Desktop::Types::PRIORITY_LAYOUT);
+	// While no window has focus, every window under the focused node of this workspace is
+	// drawn as selected: the focused window itself, or all windows of a focused group.
+	std::unordered_set<CWindow*> selected;
+	if (!Desktop::focusState()->window()) {
+		auto* root_group = this->getWorkspaceRootGroup(nullptr);
+		if (root_group != nullptr && root_group->as_group().focused_child != nullptr) {
+			for (auto& target: root_group->getFocusedNode().targets()) {
+				selected.insert(windowOf(target).get());
+			}
 		}
+	}
+
+	std::unordered_set<CWindow*> previous;
+	for (auto& ref: this->selected_windows) {
+		auto window = ref.lock();
+		if (!window) continue;
+		previous.insert(window.get());
 
-		w.updateDecorationValues();
+		if (!selected.contains(window.get())) {
+			window->m_ruleApplicator->inactiveBorderColor().unset(Desktop::Types::PRIORITY_LAYOUT);
+			window->updateDecorationValues();
+		}
+	}
+
+	this->selected_windows.clear();
+	for (auto* window: selected) {
+		this->selected_windows.emplace_back(window->m_self);
+		if (previous.contains(window)) continue;
+
+		window->m_ruleApplicator->inactiveBorderColor().set(*active_color_data, Desktop::Types::PRIORITY_LAYOUT);
+		window->updateDecorationValues();
 	}
 }
 
-void Hy3Layout::recalculate(Layout::eRecalculateReason) { this->recalcGeometry(); }
+void Hy3Layout::recalculate(Layout::eRecalculateReason) {
+	// state outside of the tree may have changed, recalculate everything now
+	this->workspace_config.valid = false;
+	if (this->root) this->root->markDirtyRecursive();
+	this->recalcGeometry();
+	this->flushGeometry();
+}
 
 void Hy3Layout::recalcGeometry(bool no_animation) {
+	this->pending_geometry.no_animation |= no_animation;
+
+	if (this->pending_geometry.scheduled) {
+		this->geometry_stats.coalesced++;
+		return;
+	}
+
+	this->pending_geometry.scheduled = true;
+	g_pendingGeometry.insert(this);
+
+	// the pass runs from the render listener, make sure there is a frame to run it in
+	if (auto monitor = this->monitor().lock()) g_pCompositor->scheduleFrameForMonitor(monitor);
+}
+
+void Hy3Layout::flushGeometry() {
+	if (!this->pending_geometry.scheduled) return;
+
+	auto no_animation = this->pending_geometry.no_animation;
+	this->pending_geometry = {};
+	g_pendingGeometry.erase(this);
+
+	this->recalcGeometryNow(no_animation);
+}
+
+void Hy3Layout::flushAllGeometry() {
+	while (!g_pendingGeometry.empty()) {
+		(*g_pendingGeometry.begin())->flushGeometry();
+	}
+}
+
+void Hy3Layout::recalcGeometryNow(bool no_animation) {
+	Hy3PerfScope perf(Hy3PerfOp::GeometryPass);
 	auto algo = m_parent.lock();
 	if (!algo) return;
 	auto space = algo->space();
@@ -431,95 +472,134 @@ void Hy3Layout::recalcGeometry(bool no_animation) {
 	if (!workspace) return;
 
 	hy3_log(LOG, "recalculating workspace {}", workspace->m_id);
+	// only the nodes this pass recalculates can have changed since the last one
+	if (g_config.check_invariants) this->checkInvariants(true);
 
 	auto ma = workspace->m_monitor->logicalBoxMinusReserved();
 	auto wa = space->workArea();
 
 	if (this->root) {
-	this->root->visualBox = wa;
-	this->root->recalcSizePosRecursive(CBox{
-	    wa.x - ma.x,
-	    wa.y - ma.y,
-	    (ma.x + ma.w) - (wa.x + wa.w),
-	    (ma.y + ma.h) - (wa.y + wa.h),
-	}, no_animation);
+		this->root->visualBox = toHy3Box(wa);
+		auto visited = this->root->recalcSizePosRecursive(
+		    Hy3Box {
+		        wa.x - ma.x,
+		        wa.y - ma.y,
+		        (ma.x + ma.w) - (wa.x + wa.w),
+		        (ma.y + ma.h) - (wa.y + wa.h),
+		    },
+		    this->geometryParams(),
+		    no_animation
+		);
+		hy3_log(TRACE, "recalculated {} nodes on workspace {}", visited, workspace->m_id);
 	}
 }
 
-ShiftDirection reverse(ShiftDirection direction) {
-	switch (direction) {
-	case ShiftDirection::Left: return ShiftDirection::Right;
-	case ShiftDirection::Right: return ShiftDirection::Left;
-	case ShiftDirection::Up: return ShiftDirection::Down;
-	case ShiftDirection::Down: return ShiftDirection::Up;
-	default: return direction;
-	}
-}
+Hy3Batch::Hy3Batch() { g_batchDepth++; }
 
-void Hy3Layout::resizeTarget(const Vector2D& delta, SP<Layout::ITarget> target, Layout::eRectCorner corner) {
-	auto* node = target ? this->getNodeFromTarget(target) : nullptr;
-	if (node == nullptr) return;
+Hy3Batch::~Hy3Batch() {
+	if (--g_batchDepth == 0) Hy3Batch::commit();
+}
 
-	auto window = node->as_window();
-	if (!valid(window)) return;
+bool Hy3Batch::active() { return g_batchDepth != 0; }
 
-	node = &node->getExpandActor();
+void Hy3Batch::commit() {
+	Hy3Layout::flushAllGeometry();
 
-	// Compare against work area since node position/size is the visible area
-	CBox workArea = {};
-	auto algo = this->m_parent.lock();
-	if (algo) {
-		auto space = algo->space();
-		if (space) workArea = space->workArea();
+	for (auto* hy3: g_hy3Instances) {
+		auto pending = std::exchange(hy3->batch_pending, {});
+		if (pending.focus_state && hy3->root) refreshFocusState(*hy3->root);
+		if (pending.border_colors) hy3->updateGroupBorderColors();
 	}
 
-	const bool display_left = STICKS(node->visualBox.x, workArea.x);
-	const bool display_right = STICKS(node->visualBox.x + node->visualBox.w, workArea.x + workArea.w);
-	const bool display_top = STICKS(node->visualBox.y, workArea.y);
-	const bool display_bottom = STICKS(node->visualBox.y + node->visualBox.h, workArea.y + workArea.h);
+	if (auto* node = std::exchange(g_batchWarp, {}).get()) warpCursorToNode(*node);
+}
+
+const Config::CCssGapData& Hy3Layout::gapsIn() {
+	static const auto p_gaps_in = CConfigValue<Config::IComplexConfigValue>("general:gaps_in");
 
-	Vector2D resize_delta = delta;
-	bool node_is_root =
-	    node->is_root()
-	    || (node->is_target() && node->parent->is_root());
+	if (!this->workspace_config.valid) {
+		auto workspace_rule = Config::workspaceRuleMgr()->getWorkspaceRuleFor(this->workspace());
+		auto gaps_in = workspace_rule.and_then([](auto r) { return r.m_gapsIn; })
+		                   .value_or(*sc<Config::CCssGapData*>(p_gaps_in.ptr()));
 
-	if (node_is_root) {
-		if (display_left && display_right) resize_delta.x = 0;
-		if (display_top && display_bottom) resize_delta.y = 0;
+		this->workspace_config = {
+		    .valid = true,
+		    .gaps_in = gaps_in,
+		    .geometry = {
+		        .gaps_in = {
+		            .top = static_cast<double>(gaps_in.m_top),
+		            .right = static_cast<double>(gaps_in.m_right),
+		            .bottom = static_cast<double>(gaps_in.m_bottom),
+		            .left = static_cast<double>(gaps_in.m_left),
+		        },
+		        .group_inset = g_config.group_inset,
+		        .tab_offset = static_cast<double>(g_config.tabs.offset),
+		    },
+		};
 	}
 
-	if (resize_delta.x == 0 && resize_delta.y == 0) return;
+	return this->workspace_config.gaps_in;
+}
 
-	ShiftDirection target_edge_x;
-	ShiftDirection target_edge_y;
+const Hy3GeometryParams& Hy3Layout::geometryParams() {
+	this->gapsIn();
+	return this->workspace_config.geometry;
+}
 
-	if (corner == Layout::CORNER_NONE) {
-		target_edge_x = display_right ? ShiftDirection::Left : ShiftDirection::Right;
-		target_edge_y = display_bottom ? ShiftDirection::Up : ShiftDirection::Down;
+void Hy3Layout::onConfigReloaded() {
+	this->workspace_config.valid = false;
+	if (this->root) this->root->markDirtyRecursive();
+	this->recalcGeometry();
 
-		if (target_edge_x == ShiftDirection::Left) resize_delta.x = -resize_delta.x;
-		if (target_edge_y == ShiftDirection::Up) resize_delta.y = -resize_delta.y;
-	} else {
-		target_edge_x = (corner & Layout::CORNER_TOPLEFT) || (corner & Layout::CORNER_BOTTOMLEFT)
-		                  ? ShiftDirection::Left
-		                  : ShiftDirection::Right;
-		target_edge_y = (corner & Layout::CORNER_TOPLEFT) || (corner & Layout::CORNER_TOPRIGHT)
-		                  ? ShiftDirection::Up
-		                  : ShiftDirection::Down;
+	// selected windows carry the old col.active_border, set them again from scratch
+	for (auto& ref: this->selected_windows) {
+		auto window = ref.lock();
+		if (!window) continue;
+		window->m_ruleApplicator->inactiveBorderColor().unset(Desktop::Types::PRIORITY_LAYOUT);
+		window->updateDecorationValues();
 	}
 
-	auto horizontal_neighbor = node->findNeighbor(target_edge_x);
-	auto vertical_neighbor = node->findNeighbor(target_edge_y);
+	this->selected_windows.clear();
+	this->updateGroupBorderColors();
+}
 
-	static const auto animate = CConfigValue<Config::INTEGER>("misc:animate_manual_resizes");
+bool Hy3Layout::geometryDirty() {
+	return this->root && (this->root->geometry_dirty || this->root->subtree_dirty);
+}
 
-	if (horizontal_neighbor) {
-		horizontal_neighbor->resize(reverse(target_edge_x), resize_delta.x, *animate == 0);
-	}
+void Hy3Layout::resizeTarget(const Vector2D& delta, SP<Layout::ITarget> target, Layout::eRectCorner corner) {
+	Hy3RecordScope record(
+	    Hy3RecordEvent::ResizeTarget,
+	    target ? target->window().get() : nullptr,
+	    recordedWorkspace(target)
+	);
+	record.entry.point = std::make_pair(delta.x, delta.y);
+	record.entry.corner = static_cast<uint8_t>(corner);
+
+	this->flushGeometry();
+
+	auto* node = target ? this->getNodeFromTarget(target) : nullptr;
+	if (node == nullptr) return;
+
+	auto window = windowOf(*node);
+	if (!valid(window)) return;
 
-	if (vertical_neighbor) {
-		vertical_neighbor->resize(reverse(target_edge_y), resize_delta.y, *animate == 0);
+	CBox workArea = {};
+	auto algo = this->m_parent.lock();
+	if (algo) {
+		auto space = algo->space();
+		if (space) workArea = space->workArea();
 	}
+
+	static const auto animate = CConfigValue<Config::INTEGER>("misc:animate_manual_resizes");
+
+	::resizeNode(
+	    *node,
+	    Hy3Point {delta.x, delta.y},
+	    toHy3Box(workArea),
+	    static_cast<Hy3ResizeCorner>(corner),
+	    *animate == 0
+	);
 }
 
 void Hy3Layout::swapTargets(SP<Layout::ITarget> a, SP<Layout::ITarget> b) {
@@ -543,36 +623,54 @@ void Hy3Layout::moveTargetInDirection(SP<Layout::ITarget> t, Math::eDirection di
 }
 
 Config::ErrorResult Hy3Layout::layoutMsg(const std::string_view& sv) {
-	std::string content(sv);
+	// a `;` separated list of commands runs as one transaction
+	auto result = runCommandList(sv, {{"togglesplit", [this]() { this->toggleSplit(); }}});
+	if (!result.success) return std::unexpected(result.error);
 
-	if (content == "togglesplit") {
-		auto window = Desktop::focusState()->window();
-		if (!window) return {};
-		auto* node = this->getNodeFromWindow(window.get());
-		if (node != nullptr) {
-			node->assertNotRoot();
-			auto& layout = node->parent->as_group().layout;
+	return {};
+}
 
-			switch (layout) {
-			case Hy3GroupLayout::SplitH:
-				layout = Hy3GroupLayout::SplitV;
-				this->recalcGeometry();
-				break;
-			case Hy3GroupLayout::SplitV:
-				layout = Hy3GroupLayout::SplitH;
-				this->recalcGeometry();
-				break;
-			case Hy3GroupLayout::Root: break;
-			case Hy3GroupLayout::Tabbed: break;
-			}
-		}
-	}
+void Hy3Layout::toggleSplit() {
+	auto window = Desktop::focusState()->window();
+	if (!window) return;
+	auto* node = this->getNodeFromWindow(window.get());
+	if (node == nullptr) return;
 
-	return {};
+	node->assertNotRoot();
+	auto& group = node->parent->as_group();
+
+	switch (group.layout) {
+	case Hy3GroupLayout::SplitH:
+		group.setLayout(Hy3GroupLayout::SplitV);
+		this->recalcGeometry();
+		break;
+	case Hy3GroupLayout::SplitV:
+		group.setLayout(Hy3GroupLayout::SplitH);
+		this->recalcGeometry();
+		break;
+	case Hy3GroupLayout::Root: break;
+	case Hy3GroupLayout::Tabbed: break;
+	}
 }
 
 std::optional<Vector2D> Hy3Layout::predictSizeForNewTarget() {
-	return std::nullopt;
+	// Runs a scheduled geometry pass now instead of before the next frame, the prediction
+	// reads the boxes it produces. hyprland inserts the target right after asking, and
+	// insertNode would run the same pass.
+	this->flushGeometry();
+
+	auto ws = this->workspace();
+	if (!valid(ws)) return std::nullopt;
+
+	auto size = predictInsertSize(
+	    this->planInsert(std::nullopt),
+	    toHy3Box(this->availableArea()),
+	    this->firstGroupLayout(),
+	    this->geometryParams()
+	);
+
+	if (!size) return std::nullopt;
+	return Vector2D(size->w, size->h);
 }
 
 SP<Layout::ITarget> Hy3Layout::getNextCandidate(SP<Layout::ITarget> old) {
@@ -584,13 +682,13 @@ SP<Layout::ITarget> Hy3Layout::getNextCandidate(SP<Layout::ITarget> old) {
 
 	auto* node = this->getNodeFromWindow(candidate.get());
 	if (!node) return nullptr;
-	return node->as_target();
+	return targetOf(*node);
 }
 
 PHLWINDOW Hy3Layout::findTiledWindowCandidate(const CWindow* from) {
 	auto* node = this->getWorkspaceFocusedNode(from->m_workspace.get(), true);
 	if (node != nullptr && node->is_target()) {
-		return node->as_window();
+		return windowOf(*node);
 	}
 
 	return PHLWINDOW();
@@ -621,14 +719,14 @@ void Hy3Layout::makeGroupOnWorkspace(
 	node = &node->getPlacementActor();
 
 	if (toggle) {
-		auto* parent = node->parent.get();
+		auto* parent = node->parent;
 		auto& group = parent->as_group();
 
 		if (group.children.size() == 1 && group.layout == layout) {
 			auto* collapsed = parent->collapseParents(CollapsePolicy::SingleNodeGroups);
 
 			if (collapsed && !collapsed->is_root()) {
-				collapsed->parent->updateTabBarRecursive();
+				updateTabBarRecursive(*collapsed->parent);
 				this->recalcGeometry();
 			}
 
@@ -698,33 +796,19 @@ void Hy3Layout::makeGroupOn(
 
 	hy3_log(LOG, "mkGrp on {:x} b4\n{}", (uintptr_t)&node, debugNodes());
 
-	node.wrap(layout, ephemeral);
-	node.parent->collapseParents(CollapsePolicy::InvalidOnly);
-	this->recalcGeometry();
+	::makeGroupOn(node, layout, ephemeral);
 }
 
 void Hy3Layout::makeOppositeGroupOn(Hy3Node& node, GroupEphemeralityOption ephemeral) {
 	node.assertNotRoot();
-
-	auto& group = node.parent->as_group();
-	auto layout =
-	    group.layout == Hy3GroupLayout::SplitH ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
-
-	if (group.children.size() == 1) {
-		group.setLayout(layout);
-		group.setEphemeral(ephemeral);
-		this->recalcGeometry();
-		return;
-	}
-
-	node.wrap(layout, ephemeral);
+	::makeOppositeGroupOn(node, ephemeral);
 }
 
 void Hy3Layout::changeGroupOn(Hy3Node& node, Hy3GroupLayout layout) {
 	node.assertNotRoot();
 	auto& group = node.parent->as_group();
 	group.setLayout(layout);
-	node.parent->updateTabBarRecursive();
+	updateTabBarRecursive(*node.parent);
 	this->recalcGeometry();
 }
 
@@ -823,8 +907,7 @@ void Hy3Layout::shiftFocus(
 			    || !node->parent->as_group().isTab();
 		}
 
-		target->focus(warp, Desktop::FOCUS_REASON_KEYBIND);
-		this->recalcGeometry();
+		focusNode(*target, warp, Desktop::FOCUS_REASON_KEYBIND);
 	}
 }
 
@@ -848,7 +931,7 @@ Hy3Node* Hy3Layout::focusMonitor(ShiftDirection direction) {
 				if (auto* hy3 = hy3InstanceForWorkspace(next_workspace)) {
 					auto found_node = hy3->getNodeFromWindow(target_window.get());
 					if (found_node) {
-						found_node->focus(true, Desktop::FOCUS_REASON_KEYBIND);
+						focusNode(*found_node, true, Desktop::FOCUS_REASON_KEYBIND);
 						return found_node;
 					}
 				} else {
@@ -877,7 +960,7 @@ bool Hy3Layout::shiftMonitor(Hy3Node& node, ShiftDirection direction, bool follo
 		Desktop::focusState()->rawMonitorFocus(next_monitor);
 		auto next_workspace = next_monitor->m_activeWorkspace;
 		if (next_workspace) {
-			moveNodeToWorkspace(node.layout()->workspace().get(), next_workspace->m_name, follow, false);
+			moveNodeToWorkspace(layoutOf(node)->workspace().get(), next_workspace->m_name, follow, false);
 			return true;
 		}
 	}
@@ -905,6 +988,8 @@ void Hy3Layout::toggleFocusLayer(const CWorkspace* workspace, bool warp) {
 }
 
 void Hy3Layout::warpCursor() {
+	Hy3Layout::flushAllGeometry();
+
 	auto current_window = Desktop::focusState()->window();
 
 	if (current_window != nullptr) {
@@ -916,13 +1001,14 @@ void Hy3Layout::warpCursor() {
 		    this->getWorkspaceFocusedNode(Desktop::focusState()->monitor()->m_activeWorkspace.get());
 
 		if (node != nullptr) {
-			Hy3Layout::warpCursorWithFocus(node->visualBox.pos() + node->visualBox.size() / 2);
+			auto box = toCBox(node->visualBox);
+			Hy3Layout::warpCursorWithFocus(box.pos() + box.size() / 2);
 		}
 	}
 }
 
 static void updateTreeTabBars(Hy3Node& node) {
-	node.updateTabBar();
+	updateTabBar(node);
 	if (node.is_group()) {
 		for (auto& child: node.as_group().children) {
 			updateTreeTabBars(*child);
@@ -952,7 +1038,7 @@ void Hy3Layout::moveNodeToWorkspace(
 	auto focused_window = Desktop::focusState()->window();
 	auto* focused_window_node = this->getNodeFromWindow(focused_window.get());
 
-	auto origin_ws = node != nullptr           ? node->layout()->workspace()
+	auto origin_ws = node != nullptr           ? layoutOf(*node)->workspace()
 	               : focused_window != nullptr ? focused_window->m_workspace
 	                                           : nullptr;
 
@@ -981,15 +1067,17 @@ void Hy3Layout::moveNodeToWorkspace(
 		    follow
 		);
 
-		auto* parent_node = node->parent.get();
+		auto* parent_node = node->parent;
 		auto node_up = parent_node->extractAndMerge(*node, nullptr);
 		auto* destHy3 = hy3InstanceForWorkspace(workspace);
 		auto* destLayout = destHy3 ? destHy3 : this;
 
 		g_suppressInsert = true;
 
-		for (auto& window: node->windows()) {
-			window.layoutTarget()->assignToSpace(workspace->m_space);
+		for (auto& target: node->targets()) {
+			targetOf(target)->assignToSpace(workspace->m_space);
+			// the space change moves the window, push its geometry again
+			target.committed.valid = false;
 		}
 
 		g_suppressInsert = false;
@@ -999,7 +1087,7 @@ void Hy3Layout::moveNodeToWorkspace(
 		Desktop::Rule::ruleEngine()->updateAllRules();
 
 		updateTreeTabBars(*node);
-		node->updateTabBarRecursive();
+		updateTabBarRecursive(*node);
 		this->recalcGeometry();
 	}
 
@@ -1014,8 +1102,8 @@ void Hy3Layout::moveNodeToWorkspace(
 
 		monitor->changeWorkspace(workspace);
 
-		node->layout()->recalcGeometry();
-		node->focus(warp, Desktop::FOCUS_REASON_KEYBIND);
+		layoutOf(*node)->recalcGeometry();
+		focusNode(*node, warp, Desktop::FOCUS_REASON_KEYBIND);
 	}
 }
 
@@ -1026,23 +1114,23 @@ void Hy3Layout::changeFocus(const CWorkspace* workspace, FocusShift shift) {
 	switch (shift) {
 	case FocusShift::Bottom: goto bottom;
 	case FocusShift::Top:
-		this->root->focus(false, Desktop::FOCUS_REASON_KEYBIND);
+		focusNode(*this->root, false, Desktop::FOCUS_REASON_KEYBIND);
 		this->updateGroupBorderColors();
 		return;
 	case FocusShift::Raise:
 		if (node->is_root_group()) goto bottom;
-		node->parent->focus(false, Desktop::FOCUS_REASON_KEYBIND);
+		focusNode(*node->parent, false, Desktop::FOCUS_REASON_KEYBIND);
 		this->updateGroupBorderColors();
 		return;
 	case FocusShift::Lower:
 		if (node->is_group() && node->as_group().focused_child != nullptr)
-			node->as_group().focused_child->focus(false, Desktop::FOCUS_REASON_KEYBIND);
+			focusNode(*node->as_group().focused_child, false, Desktop::FOCUS_REASON_KEYBIND);
 		this->updateGroupBorderColors();
 		return;
 	case FocusShift::Tab:
 		for (auto& n: node->ancestors()) {
 			if (n.parent->as_group().isTab()) {
-				n.parent->focus(false, Desktop::FOCUS_REASON_KEYBIND);
+				focusNode(*n.parent, false, Desktop::FOCUS_REASON_KEYBIND);
 				this->updateGroupBorderColors();
 				return;
 			}
@@ -1051,7 +1139,7 @@ void Hy3Layout::changeFocus(const CWorkspace* workspace, FocusShift shift) {
 	case FocusShift::TabNode:
 		for (auto& n: node->ancestors()) {
 			if (n.parent->as_group().isTab()) {
-				n.focus(false, Desktop::FOCUS_REASON_KEYBIND);
+				focusNode(n, false, Desktop::FOCUS_REASON_KEYBIND);
 				this->updateGroupBorderColors();
 				return;
 			}
@@ -1064,22 +1152,18 @@ bottom:
 		node = node->as_group().focused_child;
 	}
 
-	node->focus(false, Desktop::FOCUS_REASON_KEYBIND);
+	focusNode(*node, false, Desktop::FOCUS_REASON_KEYBIND);
 	this->updateGroupBorderColors();
 	return;
 }
 
-Hy3Node* findTabBarAt(Hy3Node& node, Vector2D pos, Hy3Node** focused_node) {
-	// clang-format off
-	static const auto p_gaps_in = CConfigValue<Config::IComplexConfigValue>("general:gaps_in");
-	static const auto tab_bar_height = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:height");
-	static const auto tab_bar_padding = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:padding");
-	// clang-format on
-
-	auto workspace_rule = Config::workspaceRuleMgr()->getWorkspaceRuleFor(node.layout()->workspace());
-	auto gaps_in = workspace_rule.and_then([](auto r) { return r.m_gapsIn; }).value_or(*sc<Config::CCssGapData*>(p_gaps_in.ptr()));
-
-	auto inset = *tab_bar_height + *tab_bar_padding + gaps_in.m_top;
+Hy3Node* findTabBarAt(
+    Hy3Node& node,
+    Vector2D pos,
+    const Config::CCssGapData& gaps_in,
+    Hy3Node** focused_node
+) {
+	auto inset = g_config.tabs.offset + gaps_in.m_top;
 
 	if (node.is_group()) {
 		if (node.hidden) return nullptr;
@@ -1089,11 +1173,12 @@ Hy3Node* findTabBarAt(Hy3Node& node, Vector2D pos, Hy3Node** focused_node) {
 			return nullptr;
 
 		auto& group = node.as_group();
+		auto& group_tab_bar = tabBarOf(group);
 
-		if (group.isTab() && group.tab_bar) {
+		if (group.isTab() && group_tab_bar) {
 			if (pos.y < node.visualBox.y + inset) {
 				auto& children = group.children;
-				auto& tab_bar = *group.tab_bar.get();
+				auto& tab_bar = *group_tab_bar.get();
 
 				auto size = tab_bar.size->value();
 				auto x = pos.x - tab_bar.pos->value().x;
@@ -1114,11 +1199,11 @@ Hy3Node* findTabBarAt(Hy3Node& node, Vector2D pos, Hy3Node** focused_node) {
 			}
 
 			if (group.focused_child != nullptr) {
-				return findTabBarAt(*group.focused_child, pos, focused_node);
+				return findTabBarAt(*group.focused_child, pos, gaps_in, focused_node);
 			}
 		} else {
 			for (auto& child: group.children) {
-				if (findTabBarAt(*child, pos, focused_node)) return child.get();
+				if (findTabBarAt(*child, pos, gaps_in, focused_node)) return child.get();
 			}
 		}
 	}
@@ -1133,6 +1218,9 @@ void Hy3Layout::focusTab(
     bool wrap_scroll,
     int index
 ) {
+	// tab bars are looked up by position
+	this->flushGeometry();
+
 	auto* node = this->getWorkspaceRootGroup(workspace);
 	if (node == nullptr) return;
 
@@ -1153,7 +1241,7 @@ void Hy3Layout::focusTab(
 		if (!window || window->m_isFloating) return;
 
 		auto mouse_pos = g_pInputManager->getMouseCoordsInternal();
-		tab_node = findTabBarAt(*node, mouse_pos, &tab_focused_node);
+		tab_node = findTabBarAt(*node, mouse_pos, this->gapsIn(), &tab_focused_node);
 		if (tab_node != nullptr) goto hastab;
 
 		if (target == TabFocus::MouseLocation || mouse == TabFocusMousePriority::Require) return;
@@ -1167,7 +1255,7 @@ void Hy3Layout::focusTab(
 		       && (tab_node->is_target()
 		           || !tab_node->as_group().isTab())
 		       && !tab_node->is_root())
-			tab_node = tab_node->parent.get();
+			tab_node = tab_node->parent;
 
 		if (tab_node == nullptr || tab_node->is_target()
 		    || !tab_node->as_group().isTab())
@@ -1181,19 +1269,8 @@ hastab:
 
 		auto& children = group.children;
 		if (target == TabFocus::Index) {
-			int i = 1;
-
-			for (auto& n: children) {
-				if (i == index) {
-					tab_focused_node = n.get();
-					goto cont;
-				}
-
-				i++;
-			}
-
-			return;
-		cont:;
+			if (index < 1 || (size_t) index > children.size()) return;
+			tab_focused_node = children[index - 1].get();
 		} else {
 			auto node_iter = group.findChild(*group.focused_child);
 			if (node_iter == children.end()) return;
@@ -1220,8 +1297,7 @@ hastab:
 	       && focus->as_group().focused_child != nullptr)
 		focus = focus->as_group().focused_child;
 
-	focus->focus(false, Desktop::FOCUS_REASON_KEYBIND);
-	this->recalcGeometry();
+	focusNode(*focus, false, Desktop::FOCUS_REASON_KEYBIND);
 }
 
 void Hy3Layout::setNodeSwallow(const CWorkspace* workspace, SetSwallowOption option) {
@@ -1246,7 +1322,7 @@ void Hy3Layout::killFocusedNode(const CWorkspace* workspace) {
 		if (node == nullptr) return;
 
 		std::vector<PHLWINDOW> windows;
-		for (auto& w: node->windows()) windows.push_back(w.m_self.lock());
+		for (auto& target: node->targets()) windows.push_back(windowOf(target));
 
 		for (auto& window: windows) {
 			window->setHidden(false);
@@ -1262,52 +1338,15 @@ void Hy3Layout::expand(
 ) {
 	auto* node = this->getWorkspaceFocusedNode(workspace, false, true);
 	if (node == nullptr) return;
-	PHLWINDOW window;
-
-	switch (option) {
-	case ExpandOption::Expand: {
-		node->assertNotRoot();
-
-		if (node->is_group() && !node->as_group().group_focused)
-			node->as_group().expand_focused = ExpandFocusType::Stack;
-
-		auto& group = node->parent->as_group();
-		group.focused_child = node;
-		group.expand_focused = ExpandFocusType::Latch;
+	::expandNode(*node, option);
 
-		this->recalcGeometry();
-
-		if (node->parent->is_root()) {
-			switch (fs_option) {
-			case ExpandFullscreenOption::MaximizeAsFullscreen: // goto fullscreen;
-			case ExpandFullscreenOption::MaximizeIntermediate:
-			case ExpandFullscreenOption::MaximizeOnly: return;
-			}
-		}
-	} break;
-	case ExpandOption::Shrink:
-		if (node->is_group()) {
-			auto& group = node->as_group();
-
-			group.expand_focused = ExpandFocusType::NotExpanded;
-			if (group.focused_child->is_group())
-				group.focused_child->as_group().expand_focused = ExpandFocusType::Latch;
-
-			this->recalcGeometry();
+	if (option == ExpandOption::Expand && node->parent->is_root()) {
+		switch (fs_option) {
+		case ExpandFullscreenOption::MaximizeAsFullscreen: // goto fullscreen;
+		case ExpandFullscreenOption::MaximizeIntermediate:
+		case ExpandFullscreenOption::MaximizeOnly: return;
 		}
-		break;
-	case ExpandOption::Base: {
-		if (node->is_group()) {
-			node->as_group().collapseExpansions();
-			this->recalcGeometry();
-		}
-		break;
 	}
-	case ExpandOption::Maximize: break;
-	case ExpandOption::Fullscreen: break;
-	}
-
-	return;
 }
 
 void Hy3Layout::setTabLock(const CWorkspace* workspace, TabLockMode mode) {
@@ -1325,18 +1364,10 @@ void Hy3Layout::setTabLock(const CWorkspace* workspace, TabLockMode mode) {
 		case TabLockMode::Toggle: group.locked = !group.locked; break;
 		}
 
-		node.parent->updateTabBar();
-		return;
-	}
-}
-
-static void equalizeRecursive(Hy3Node* node, bool recursive) {
-	node->size_ratio = 1.0f;
+		group.version++;
 
-	if (recursive && node->is_group()) {
-		for (auto& child: node->as_group().children) {
-			equalizeRecursive(child.get(), true);
-		}
+		updateTabBar(*node.parent);
+		return;
 	}
 }
 
@@ -1348,19 +1379,12 @@ void Hy3Layout::equalize(const CWorkspace* workspace, bool recursive) {
 
 	if (recursive) {
 		target = this->getWorkspaceRootGroup(workspace);
-		if (target != nullptr) {
-			equalizeRecursive(target, true);
-		}
 	} else {
 		focused->assertNotRoot();
-		auto* parent = focused->parent.get();
-		equalizeRecursive(parent, false);
-		target = parent;
+		target = focused->parent;
 	}
 
-	if (target != nullptr) {
-		this->recalcGeometry();
-	}
+	if (target != nullptr) ::equalizeNode(*target, recursive);
 }
 
 void Hy3Layout::warpCursorToBox(const Vector2D& pos, const Vector2D& size) {
@@ -1387,36 +1411,78 @@ void Hy3Layout::warpCursorWithFocus(const Vector2D& target, bool force) {
 }
 
 std::string Hy3Layout::debugNodes() {
+	Hy3PerfScope perf(Hy3PerfOp::DebugNodes);
 	std::string output;
 
 	for (auto* hy3: g_hy3Instances) {
 		if (!hy3->root) continue;
 		output += hy3->root->debugNode();
-		output += "\n";
+
+		auto pool = hy3->node_pool->stats();
+		output += std::format(
+		    "\nnode pool: {}/{} slots used in {} slabs\n",
+		    pool.live,
+		    pool.capacity,
+		    pool.slabs
+		);
+
+		output += std::format(
+		    "geometry pushes: {}, skipped: {}, coalesced passes: {}\n",
+		    hy3->geometry_stats.pushes,
+		    hy3->geometry_stats.skipped,
+		    hy3->geometry_stats.coalesced
+		);
 	}
 
 	return output;
 }
 
-bool Hy3Layout::shouldRenderSelected(const CWindow* window) {
-	if (window == nullptr) return false;
-	if (Desktop::focusState()->window()) return false;
+bool Hy3Layout::checkInvariants(bool dirty_only) {
+	if (!this->root) return true;
 
-	auto* root = this->getWorkspaceRootGroup(window->m_workspace.get());
-	if (root == nullptr || root->as_group().focused_child == nullptr) return false;
-	auto* focused = &root->getFocusedNode();
+	std::vector<std::string> errors;
+	std::vector<Hy3TargetNode*> targets;
+	this->root->checkInvariants(errors, targets, dirty_only);
 
-	switch (focused->type()) {
-	case Hy3NodeType::Target: return focused->as_window().get() == window;
-	case Hy3NodeType::Group: {
-		auto* node = this->getNodeFromWindow(window);
-		if (node == nullptr) return false;
-		return focused->as_group().hasChild(*node);
-	}
+	for (auto* target: targets) {
+		auto it = this->target_nodes.find(asWindowNode(*target).target_key);
+		if (it == this->target_nodes.end() || it->second != target)
+			errors.push_back(std::format("target node {:x} is not indexed by its layout", (uintptr_t) target));
 	}
+
+	// the cached count avoids walking clean subtrees
+	auto target_count = dirty_only ? this->root->windowCount() : targets.size();
+	if (target_count != this->target_nodes.size())
+		errors.push_back(
+		    std::format("tree has {} target nodes but {} are indexed", target_count, this->target_nodes.size())
+		);
+
+	if (errors.empty()) return true;
+
+	for (auto& error: errors) hy3_log(ERR, "invariant violated: {}", error);
+	hy3_log(ERR, "node tree:\n{}", this->root->debugNode());
+	errorNotif();
 	return false;
 }
 
+std::optional<Hy3RecordWorkspace> Hy3Layout::recordSnapshot() {
+	auto ws = this->workspace();
+	if (!valid(ws) || !this->root) return std::nullopt;
+
+	// the recorded events start from the geometry of the next frame
+	this->flushGeometry();
+
+	return Hy3RecordWorkspace {
+	    .id = ws->m_id,
+	    .area = this->root->visualBox,
+	    .offsets = this->root->last_offsets,
+	    .params = this->geometryParams(),
+	    .root = Hy3Recorder::capture(*this->root, [](Hy3TargetNode& target) -> const void* {
+		    return asWindowNode(target).window_key;
+	    }),
+	};
+}
+
 Hy3Node* Hy3Layout::getWorkspaceRootGroup(const CWorkspace* workspace) {
 	if (!this->root) return nullptr;
 	auto& group = this->root->as_group();
@@ -1434,235 +1500,144 @@ Hy3Node* Hy3Layout::getWorkspaceFocusedNode(
 	return &rootNode->getFocusedNode(ignore_group_focus, stop_at_expanded);
 }
 
-Hy3Node* Hy3Layout::getNodeFromWindow(const CWindow* window) {
-	if (!this->root || !window) return nullptr;
-	for (auto& w: this->root->windows()) {
-		if (&w == window) return getNodeFromTarget(w.layoutTarget());
-	}
-	return nullptr;
-}
+// The indexes are keyed by address, which hyprland reuses once a target is freed. An
+// entry only matches while its node's target is still the object the key was taken from,
+// stale entries are dropped on lookup.
+template <typename K>
+static Hy3Node* findIndexEntry(
+    std::unordered_map<K, Hy3Node*>& index,
+    K key,
+    K (*current_key)(Layout::ITarget&)
+) {
+	auto it = index.find(key);
+	if (it == index.end()) return nullptr;
 
-static Hy3Node* findNodeFromTargetRecursive(Hy3Node* node, SP<Layout::ITarget> target) {
-	if (!node) return nullptr;
-	if (node->is_target() && node->as_target() == target) {
-		return node;
-	}
-	if (node->is_group()) {
-		for (auto& child: node->as_group().children) {
-			auto* result = findNodeFromTargetRecursive(child.get(), target);
-			if (result) return result;
-		}
-	}
+	auto target = asWindowNode(*it->second).target.lock();
+	if (target && current_key(*target) == key) return it->second;
+
+	hy3_log(WARN, "dropping stale index entry {:x} for node {:x}", (uintptr_t) key, (uintptr_t) it->second);
+	index.erase(it);
 	return nullptr;
 }
 
-Hy3Node* Hy3Layout::getNodeFromTarget(SP<Layout::ITarget> target) {
-	return findNodeFromTargetRecursive(this->root.get(), target);
-}
+Hy3Node* Hy3Layout::getNodeFromWindow(const CWindow* window) {
+	Hy3PerfScope perf(Hy3PerfOp::GetNodeFromWindow);
+	if (!window) return nullptr;
 
-bool shiftIsForward(ShiftDirection direction) {
-	return direction == ShiftDirection::Right || direction == ShiftDirection::Down;
+	return findIndexEntry<const CWindow*>(this->window_nodes, window, [](Layout::ITarget& target) {
+		return static_cast<const CWindow*>(target.window().get());
+	});
 }
 
-bool shiftIsVertical(ShiftDirection direction) {
-	return direction == ShiftDirection::Up || direction == ShiftDirection::Down;
-}
+Hy3Node* Hy3Layout::getNodeFromTarget(SP<Layout::ITarget> target) {
+	if (!target) return nullptr;
 
-bool shiftMatchesLayout(Hy3GroupLayout layout, ShiftDirection direction) {
-	if (layout == Hy3GroupLayout::Root) return false;
-	return (layout == Hy3GroupLayout::SplitV && shiftIsVertical(direction))
-	    || (layout != Hy3GroupLayout::SplitV && !shiftIsVertical(direction));
+	return findIndexEntry<const Layout::ITarget*>(this->target_nodes, target.get(), [](Layout::ITarget& target) {
+		return static_cast<const Layout::ITarget*>(&target);
+	});
 }
 
-Hy3Node* Hy3Layout::shiftOrGetFocus(
-    Hy3Node& node,
-    ShiftDirection direction,
-    bool shift,
-    bool once,
-    bool visible
-) {
-	auto* expand_actor = &node.getExpandActor();
-	auto* break_origin = &expand_actor->getPlacementActor();
-	auto* shift_actor = break_origin;
-	auto* break_parent = break_origin->parent.get();
+void Hy3Layout::onAttached(Hy3Node& node) {
+	if (node.is_group()) {
+		for (auto& child: node.as_group().children) {
+			this->onAttached(*child);
+		}
 
-	auto has_broken_once = false;
+		return;
+	}
 
-	// break parents until we hit a container oriented the same way as the shift
-	// direction
-	while (true) {
-		if (break_parent == nullptr) return nullptr;
+	auto& target_node = asWindowNode(node);
+	if (target_node.target_key != nullptr) this->target_nodes[target_node.target_key] = &node;
+	if (target_node.window_key != nullptr) this->window_nodes[target_node.window_key] = &node;
+}
 
-		auto& group = break_parent->as_group(); // must be a group in order to be a parent
+template <typename K>
+static void eraseIndexEntry(std::unordered_map<K, Hy3Node*>& index, K key, Hy3Node* node) {
+	if (key == nullptr) return;
+	auto it = index.find(key);
+	if (it != index.end() && it->second == node) index.erase(it);
+}
 
-		if (shiftMatchesLayout(group.layout, direction)
-		    && (!visible || !group.isTab()))
-		{
-			// group has the correct orientation
-
-			if (once && shift && has_broken_once) break;
-			if (break_origin != shift_actor) has_broken_once = true;
-
-			// if this movement would break out of the group, continue the break loop
-			// (do not enter this if) otherwise break.
-			if ((has_broken_once && once && shift)
-			    || !(
-			        (!shiftIsForward(direction) && group.children.front().get() == break_origin)
-			        || (shiftIsForward(direction) && group.children.back().get() == break_origin)
-			    ))
-				break;
+void Hy3Layout::onDetached(Hy3Node& node) {
+	if (node.is_group()) {
+		for (auto& child: node.as_group().children) {
+			this->onDetached(*child);
 		}
 
-		if (break_parent->is_root()) {
-			if (!shift) return focusMonitor(direction);
+		return;
+	}
 
-			auto new_layout =
-			    shiftIsVertical(direction) ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
-			break_origin->wrap(new_layout, GroupEphemeralityOption::Standard);
-			break_parent = break_origin->parent.get();
-			break;
-		}
+	auto& target_node = asWindowNode(node);
+	eraseIndexEntry(this->target_nodes, target_node.target_key, &node);
+	eraseIndexEntry(this->window_nodes, target_node.window_key, &node);
+}
 
-		// special case 1-child nodes so once will only break the group
-		if (once && shift && break_origin->is_group() && break_origin->as_group().children.size() == 1) {
-			break;
-		}
+std::unique_ptr<Hy3Node> Hy3Layout::createGroup(Hy3GroupLayout layout) {
+	return Hy3WindowGroup::create(*this->node_pool, layout);
+}
 
-		break_origin = break_parent;
-		break_parent = break_origin->parent.get();
+static bool isAncestorOrSelf(Hy3Node& ancestor, Hy3Node& node) {
+	for (auto* n = &node; n != nullptr; n = n->parent) {
+		if (n == &ancestor) return true;
 	}
 
-	auto& parent_group = break_parent->as_group();
-	Hy3Node* target_group = break_parent;
-	std::list<UP<Hy3Node>>::iterator insert;
-
-	if (break_origin == parent_group.children.front().get() && !shiftIsForward(direction)) {
-		if (!shift) return nullptr;
-		insert = parent_group.children.begin();
-	} else if (break_origin == parent_group.children.back().get() && shiftIsForward(direction)) {
-		if (!shift) return nullptr;
-		insert = parent_group.children.end();
-	} else {
-		auto& group_data = target_group->as_group();
-
-		auto iter = group_data.findChild(*break_origin);
-		if (shiftIsForward(direction)) iter = std::next(iter);
-		else iter = std::prev(iter);
-
-		auto& node = **iter;
-		if (node.is_target()
-				|| (node.is_group()
-						&& (node.as_group().expand_focused != ExpandFocusType::NotExpanded
-								|| node.as_group().locked))
-				|| (shift && once && has_broken_once))
-		{
-			if (shift) {
-				if (target_group == shift_actor->parent.get()) {
-					if (shiftIsForward(direction)) insert = std::next(iter);
-					else insert = iter;
-				} else {
-					if (shiftIsForward(direction)) insert = iter;
-					else insert = std::next(iter);
-				}
-			} else return &(*iter)->getFocusedNode();
-		} else {
-			// break into neighboring groups until we hit a window
-			while (true) {
-				target_group = iter->get();
-				auto& group_data = target_group->as_group();
-
-				if (group_data.children.empty()) return nullptr; // in theory this would never happen
-
-				bool shift_after = false;
-
-				if (!shift && group_data.isTab()
-				    && group_data.focused_child != nullptr)
-				{
-					iter = group_data.findChild(*group_data.focused_child);
-				} else if (visible && group_data.isTab()
-				           && group_data.focused_child != nullptr)
-				{
-					// if the group is tabbed and we're going by visible nodes, jump to the current entry
-					iter = group_data.findChild(*group_data.focused_child);
-					shift_after = true;
-				} else if (shiftMatchesLayout(group_data.layout, direction)
-				           || (visible && group_data.isTab()))
-				{
-					// if the group has the same orientation as movement pick the
-					// last/first child based on movement direction
-					if (shiftIsForward(direction)) iter = group_data.children.begin();
-					else {
-						iter = std::prev(group_data.children.end());
-						shift_after = true;
-					}
-				} else {
-					if (group_data.focused_child != nullptr) {
-						iter = group_data.findChild(*group_data.focused_child);
-						shift_after = true;
-					} else {
-						iter = group_data.children.begin();
-					}
-				}
+	return false;
+}
 
-				if (shift && once) {
-					if (shift_after) insert = std::next(iter);
-					else insert = iter;
-					break;
-				}
+void Hy3Layout::onFocusChanged(Hy3Node& old_focus, Hy3Node& focus) {
+	// focus changes in tab and expanded groups move geometry, schedule the pass for every
+	// caller here so none of them can leave it pending
+	if (this->geometryDirty()) this->recalcGeometry();
 
-				if ((*iter)->is_target()
-				    || ((*iter)->is_group()
-				        && (*iter)->as_group().expand_focused != ExpandFocusType::NotExpanded))
-				{
-					if (shift) {
-						if (shift_after) insert = std::next(iter);
-						else insert = iter;
-						break;
-					} else {
-						return &(*iter)->getFocusedNode();
-					}
-				}
-			}
-		}
+	if (Hy3Batch::active()) {
+		this->batch_pending.focus_state = true;
+		return;
 	}
 
-	auto& group_data = target_group->as_group();
-
-	if (target_group == shift_actor->parent.get()) {
-		// Reorder within the same group via splice (handles boundary no-ops naturally)
-		auto shift_it = group_data.findChild(*shift_actor);
-		group_data.children.splice(insert, group_data.children, shift_it);
-		shift_actor->parent->collapseParents(nodeCollapsePolicy());
-	} else if (!shift_actor->parent->is_root() && shift_actor->parent->as_group().children.size() == 1 && target_group == shift_actor->parent->parent.get()) {
-		// special cased to prevent size being reset to 1 on group break
-		auto shift_parent = shift_actor->parent;
-		auto shift_actor_u = shift_parent->as_group().extractChildRaw(*shift_actor);
-		auto iter = std::ranges::find(group_data.children, shift_parent);
-		group_data.replaceChild(iter, std::move(shift_actor_u));
+	// Only nodes under the old or new focus change focus state. When one contains the
+	// other, refreshing the outer one covers both.
+	if (isAncestorOrSelf(old_focus, focus)) {
+		refreshFocusState(old_focus);
+	} else if (isAncestorOrSelf(focus, old_focus)) {
+		refreshFocusState(focus);
 	} else {
-		auto target_group_p = target_group->self;
-		auto* shift_parent = shift_actor->parent.get();
-		auto shift_actor_u = shift_parent->as_group().extractChild(*shift_actor);
+		refreshFocusState(old_focus);
+		refreshFocusState(focus);
+	}
+}
 
-		group_data.insertChild(insert, std::move(shift_actor_u));
+void Hy3Layout::onGroupCollapsed(Hy3GroupNode& group, Hy3Node& child) {
+	// HACK: steal titlebar from parent if we have a new node, prevents visual issues if rewrapped
+	if (child.is_group() && group.isTab() && child.as_group().isTab()) {
+		auto& n = tabBarOf(child.as_group());
+		auto& o = tabBarOf(group);
+		if (n->bar.entries.empty() || n->bar.entries.front().vertical_pos->value() == 1) n = std::move(o);
+	}
+}
 
-		shift_parent = shift_parent->collapseParents(CollapsePolicy::InvalidOnly);
+void Hy3Layout::onGroupGeometry(Hy3GroupNode& group, bool no_animation) {
+	updateTabBar(group, no_animation);
+}
 
-		if (shift_parent != nullptr) {
-			shift_parent->updateTabBarRecursive();
-		}
+void Hy3Layout::refreshTabBars(Hy3Node& node) { updateTabBarRecursive(node); }
 
-		// Collapse any single-child groups left over from wrapping/extraction
-		if (target_group_p) {
-			target_group_p->collapseParents(nodeCollapsePolicy());
-		}
-	}
+std::string Hy3Layout::describe() {
+	auto ws = this->workspace();
+	return std::format("workspace {}", ws ? ws->m_id : -1);
+}
 
-	node.updateTabBarRecursive();
-	node.focus(false, Desktop::FOCUS_REASON_KEYBIND);
-	this->recalcGeometry();
+Hy3Node* Hy3Layout::shiftOrGetFocus(
+    Hy3Node& node,
+    ShiftDirection direction,
+    bool shift,
+    bool once,
+    bool visible
+) {
+	auto result = ::shiftOrGetFocus(node, direction, shift, once, visible, nodeCollapsePolicy());
+	if (result.out_of_tree) return focusMonitor(direction);
 
-	return nullptr;
+	if (result.shifted) focusNode(node, false, Desktop::FOCUS_REASON_KEYBIND);
+	return result.focus;
 }
 
 void Hy3Layout::updateAutotileWorkspaces() {
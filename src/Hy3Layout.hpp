@@ -3,13 +3,9 @@
 #include <hyprland/src/desktop/DesktopTypes.hpp>
 class Hy3Layout;
 
-enum class GroupEphemeralityOption {
-	Ephemeral,
-	Standard,
-	ForceEphemeral,
-};
-
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 #include <hyprland/src/layout/algorithm/TiledAlgorithm.hpp>
 #include <hyprland/src/layout/algorithm/Algorithm.hpp>
@@ -20,18 +16,11 @@ enum class GroupEphemeralityOption {
 #include <hyprland/src/helpers/signal/Signal.hpp>
 #include <hyprland/src/event/EventBus.hpp>
 
-enum class ShiftDirection {
-	Left,
-	Up,
-	Down,
-	Right,
-};
-inline static constexpr char getShiftDirectionChar(ShiftDirection direction) {
-	return direction == ShiftDirection::Left ? 'l'
-	     : direction == ShiftDirection::Up   ? 'u'
-	     : direction == ShiftDirection::Down ? 'd'
-	                                         : 'r';
-}
+#include "config/shared/complex/ComplexDataTypes.hpp"
+#include "Hy3Node.hpp"
+#include "Hy3Tree.hpp"
+#include "Hy3WindowNode.hpp"
+#include "record.hpp"
 
 inline static Math::eDirection shiftToMathDirection(ShiftDirection direction) {
 	switch (direction) {
@@ -43,11 +32,6 @@ inline static Math::eDirection shiftToMathDirection(ShiftDirection direction) {
 	return Math::DIRECTION_DEFAULT;
 }
 
-enum class Axis { None, Horizontal, Vertical };
-
-#include "Hy3Node.hpp"
-#include "TabGroup.hpp"
-
 enum class FocusShift {
 	Top,
 	Bottom,
@@ -82,14 +66,6 @@ enum class SetSwallowOption {
 	Toggle,
 };
 
-enum class ExpandOption {
-	Expand,
-	Shrink,
-	Base,
-	Maximize,
-	Fullscreen,
-};
-
 enum class ExpandFullscreenOption {
 	MaximizeOnly,
 	MaximizeIntermediate,
@@ -98,7 +74,24 @@ enum class ExpandFullscreenOption {
 
 PHLWORKSPACE workspace_for_action(bool allow_fullscreen = false);
 
-class Hy3Layout: public Layout::ITiledAlgorithm {
+// While a batch is open, focus state refreshes, border color updates and cursor warps
+// are deferred, and are committed together with any scheduled geometry passes when
+// the outermost batch is destroyed. Used to run command lists as one transaction.
+struct Hy3Batch {
+	Hy3Batch();
+	~Hy3Batch();
+	Hy3Batch(const Hy3Batch&) = delete;
+	Hy3Batch& operator=(const Hy3Batch&) = delete;
+
+	static bool active();
+
+private:
+	static void commit();
+};
+
+class Hy3Layout
+    : public Layout::ITiledAlgorithm
+    , public Hy3TreeHost {
 public:
 	Hy3Layout();
 	~Hy3Layout() override;
@@ -109,18 +102,50 @@ public:
 	void removeTarget(SP<Layout::ITarget> target) override;
 	void resizeTarget(const Vector2D& delta, SP<Layout::ITarget> target, Layout::eRectCorner corner = Layout::CORNER_NONE) override;
 	void recalculate(Layout::eRecalculateReason reason) override;
-	void recalcGeometry(bool no_animation = false);
+	// Schedule a geometry pass before the next frame. Repeated calls are coalesced.
+	void recalcGeometry(bool no_animation = false) override;
+	// Run a scheduled geometry pass now, for callers that read node geometry.
+	void flushGeometry() override;
+	// Run every scheduled geometry pass.
+	static void flushAllGeometry();
+	// true if a node was marked dirty since the last geometry pass
+	bool geometryDirty();
+	// true if a geometry pass will run before the next frame
+	bool geometryScheduled() const { return this->pending_geometry.scheduled; }
+	// general:gaps_in resolved against this layout's workspace rule. Cached until the next
+	// recalculate(), which hyprland runs after config reloads and monitor changes.
+	const Config::CCssGapData& gapsIn();
+	// gapsIn() and the g_config values read by the geometry pass, cached along with it
+	const Hy3GeometryParams& geometryParams();
+	// Drop state derived from the config and relayout with the new g_config.
+	void onConfigReloaded();
 	void swapTargets(SP<Layout::ITarget> a, SP<Layout::ITarget> b) override;
 	void moveTargetInDirection(SP<Layout::ITarget> t, Math::eDirection dir, bool silent) override;
 	Config::ErrorResult layoutMsg(const std::string_view& sv) override;
+	// Runs a scheduled geometry pass early, the one inserting the target would run.
 	std::optional<Vector2D> predictSizeForNewTarget() override;
 	SP<Layout::ITarget> getNextCandidate(SP<Layout::ITarget> old) override;
 
+	// Hy3TreeHost overrides
+	std::unique_ptr<Hy3Node> createGroup(Hy3GroupLayout layout) override;
+	// add or remove every target node under the given node from the window / target index.
+	void onAttached(Hy3Node&) override;
+	void onDetached(Hy3Node&) override;
+	void onFocusChanged(Hy3Node& old_focus, Hy3Node& focus) override;
+	void onGroupCollapsed(Hy3GroupNode& group, Hy3Node& child) override;
+	void onGroupGeometry(Hy3GroupNode& group, bool no_animation) override;
+	void refreshTabBars(Hy3Node& node) override;
+	std::string describe() override;
+
 	// Hy3-specific public methods
-	void insertNode(UP<Hy3Node> node, std::optional<Vector2D> focalPoint = std::nullopt);
+	void insertNode(std::unique_ptr<Hy3Node> node, std::optional<Vector2D> focalPoint = std::nullopt);
 	void onWindowFocusChange(PHLWINDOW window);
 	void updateGroupBorderColors();
 
+	// Global event handlers, routed to the layout owning the affected window.
+	static void onWindowActive(PHLWINDOW window);
+	static void onMouseButton(IPointer::SButtonEvent event, Event::SCallbackInfo& info);
+
 	void makeGroupOnWorkspace(
 	    const CWorkspace* workspace,
 	    Hy3GroupLayout,
@@ -148,6 +173,7 @@ public:
 	Hy3Node* focusMonitor(ShiftDirection);
 
 	void warpCursor();
+	void toggleSplit();
 	void moveNodeToWorkspace(CWorkspace* origin, std::string wsname, bool follow, bool warp);
 	void changeFocus(const CWorkspace* workspace, FocusShift);
 	void focusTab(
@@ -165,8 +191,12 @@ public:
 	static void warpCursorToBox(const Vector2D& pos, const Vector2D& size);
 	static void warpCursorWithFocus(const Vector2D& pos, bool force = false);
 	static std::string debugNodes();
+	// Log every broken tree invariant, run before each geometry pass on the nodes it will
+	// recalculate when debug:check_invariants is set. Returns false if any were found.
+	bool checkInvariants(bool dirty_only = false);
+	// State of this layout's workspace for the snapshot hy3:record starts with.
+	std::optional<Hy3RecordWorkspace> recordSnapshot();
 
-	bool shouldRenderSelected(const Desktop::View::CWindow*);
 	PHLWINDOW findTiledWindowCandidate(const Desktop::View::CWindow* from);
 	PHLWINDOW findFloatingWindowCandidate(const Desktop::View::CWindow* from);
 
@@ -182,8 +212,9 @@ public:
 
 	PHLWORKSPACE workspace();
 	PHLMONITORREF monitor();
+	Hy3NodePool& nodePool() override { return *this->node_pool; }
 
-	UP<Hy3RootNode> root;
+	std::unique_ptr<Hy3GroupNode> root;
 
 private:
 	// if shift is true, shift the window in the given direction, returning
@@ -194,9 +225,45 @@ private:
 	void updateAutotileWorkspaces();
 	bool shouldAutotileWorkspace(const CWorkspace* workspace);
 
-	// Per-instance event listeners
-	CHyprSignalListener m_windowActiveListener;
-	CHyprSignalListener m_mouseButtonListener;
+	// see ::planInsert, with the node under the focal point and autotile settings of
+	// this layout's workspace
+	Hy3InsertPlan planInsert(std::optional<Vector2D> focalPoint);
+	// layout of the root group created for the first node of the workspace
+	Hy3GroupLayout firstGroupLayout();
+	// the space work area, or the monitor box without a space
+	CBox availableArea();
+
+	// focus the tab under the cursor, returns false if there is none
+	bool focusTabAtCursor();
+
+	void recalcGeometryNow(bool no_animation);
+
+	// released (not freed) on destruction, nodes moved to other layouts keep it alive
+	Hy3NodePool* node_pool;
+
+	// keyed by address, see findIndexEntry for how reused addresses are handled
+	std::unordered_map<const Desktop::View::CWindow*, Hy3Node*> window_nodes;
+	std::unordered_map<const Layout::ITarget*, Hy3Node*> target_nodes;
+
+	// windows currently drawn with the active border by updateGroupBorderColors
+	std::vector<PHLWINDOWREF> selected_windows;
+
+	struct {
+		bool scheduled = false;
+		bool no_animation = false;
+	} pending_geometry;
+
+	struct {
+		bool valid = false;
+		Config::CCssGapData gaps_in;
+		Hy3GeometryParams geometry;
+	} workspace_config;
+
+	// work deferred by an open Hy3Batch
+	struct {
+		bool focus_state = false;
+		bool border_colors = false;
+	} batch_pending;
 
 	struct {
 		std::string raw_workspaces;
@@ -204,5 +271,5 @@ private:
 		std::set<int> workspaces;
 	} autotile;
 
-	friend struct Hy3Node;
+	friend struct Hy3Batch;
 };
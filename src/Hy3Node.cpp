@@ -1,27 +1,16 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <format>
 #include <sstream>
 #include <stdexcept>
 
-#include <bits/ranges_util.h>
-#include <hyprland/src/Compositor.hpp>
-#include <hyprland/src/desktop/state/FocusState.hpp>
-#include <hyprland/src/config/ConfigManager.hpp>
-#include <hyprland/src/defines.hpp>
-#include <hyprland/src/plugins/PluginAPI.hpp>
-#include <hyprland/src/config/shared/workspace/WorkspaceRuleManager.hpp>
-#include <hyprutils/math/Box.hpp>
-
-#include "config/shared/complex/ComplexDataTypes.hpp"
 #include "log.hpp"
-#include "Hy3Layout.hpp"
 #include "Hy3Node.hpp"
-#include "globals.hpp"
-
-using Desktop::View::CWindow;
-
-const float MIN_RATIO = 0.0f;
+#include "geometry.hpp"
+#include "perf.hpp"
 
-Hy3GroupNode::Hy3GroupNode(Hy3GroupLayout layout): layout(layout) {
+Hy3GroupNode::Hy3GroupNode(Hy3GroupLayout layout): Hy3Node(Hy3NodeType::Group), layout(layout) {
 	if (!isTab()) {
 		this->previous_nontab_layout = layout;
 	}
@@ -30,20 +19,40 @@ Hy3GroupNode::Hy3GroupNode(Hy3GroupLayout layout): layout(layout) {
 bool Hy3Node::is_root() { return is_group() && as_group().layout == Hy3GroupLayout::Root; }
 bool Hy3Node::is_root_group() { return !is_root() && parent->is_root(); }
 
-Hy3RootNode::Hy3RootNode(Hy3Layout* layout)
-    : Hy3GroupNode(Hy3GroupLayout::Root), algo(layout) {}
-
-Hy3RootNode* Hy3Node::root() {
+Hy3GroupNode* Hy3Node::root() {
 	auto* node = this;
-	while (!node->is_root() && node->parent.get() != nullptr) {
-		node = node->parent.get();
+	while (!node->is_root() && node->parent != nullptr) {
+		node = node->parent;
 	}
-	return dynamic_cast<Hy3RootNode*>(node);
+
+	return node->is_root() ? &node->as_group() : nullptr;
 }
 
-Hy3Layout* Hy3Node::layout() {
+Hy3TreeHost* Hy3Node::host() {
 	auto* r = root();
-	return r ? r->algo : nullptr;
+	return r ? r->tree_host : nullptr;
+}
+
+uint64_t Hy3Node::nextId() {
+	static uint64_t next_id = 1;
+	return next_id++;
+}
+
+Hy3NodeRef Hy3Node::ref() {
+	if (!this->ref_anchor) this->ref_anchor = std::make_shared<Hy3Node* const>(this);
+
+	Hy3NodeRef ref;
+	ref.ref = this->ref_anchor;
+	return ref;
+}
+
+Hy3Node* Hy3NodeRef::get() const {
+	auto anchor = this->ref.lock();
+	return anchor ? *anchor : nullptr;
+}
+
+std::unique_ptr<Hy3Node> Hy3TreeHost::createGroup(Hy3GroupLayout layout) {
+	return Hy3GroupNode::create(this->nodePool(), layout);
 }
 
 void Hy3Node::assertNotRoot() {
@@ -65,26 +74,40 @@ bool Hy3GroupNode::hasChild(Hy3Node& node) {
 	return false;
 }
 
-auto Hy3GroupNode::findChild(Hy3Node& child) -> std::list<UP<Hy3Node>>::iterator {
-	for (auto it = children.begin(); it != children.end(); ++it) {
-		if (it->get() == &child) return it;
+auto Hy3GroupNode::findChild(Hy3Node& child) -> Hy3NodeList::iterator {
+	auto index = child.child_index;
+	if (index >= children.size() || children[index].get() != &child) return children.end();
+	return children.begin() + index;
+}
+
+void Hy3GroupNode::reindexChildren(size_t from) {
+	for (auto i = from; i < children.size(); i++) {
+		children[i]->child_index = i;
 	}
-	return children.end();
 }
 
-void Hy3GroupNode::insertChild(std::list<UP<Hy3Node>>::iterator pos, UP<Hy3Node> child) {
-	child->parent = this->self;
+void Hy3GroupNode::insertChild(Hy3NodeList::iterator pos, std::unique_ptr<Hy3Node> child) {
+	child->parent = this;
 	if (focused_child == nullptr) focused_child = child.get();
+	if (auto* host = this->host()) host->onAttached(*child);
+	auto index = pos - children.begin();
+	auto* child_ptr = child.get();
 	children.insert(pos, std::move(child));
+	reindexChildren(index);
+	this->invalidateAggregates();
+	this->bumpVersion();
+	this->markDirty();
+	// geometry committed in another tree or workspace says nothing about this one
+	child_ptr->markDirtyRecursive();
 	if (ephemeral == Ephemeral::Staged && children.size() >= 2)
 		ephemeral = Ephemeral::Active;
 }
 
-void Hy3GroupNode::insertChild(UP<Hy3Node> child) {
+void Hy3GroupNode::insertChild(std::unique_ptr<Hy3Node> child) {
 	insertChild(children.end(), std::move(child));
 }
 
-UP<Hy3Node> Hy3GroupNode::extractChildRaw(std::list<UP<Hy3Node>>::iterator it) {
+std::unique_ptr<Hy3Node> Hy3GroupNode::extractChildRaw(Hy3NodeList::iterator it) {
 	auto* child_ptr = it->get();
 
 	// Fix focused_child if we're extracting it
@@ -98,19 +121,26 @@ UP<Hy3Node> Hy3GroupNode::extractChildRaw(std::list<UP<Hy3Node>>::iterator it) {
 		}
 	}
 
+	auto index = it - children.begin();
 	auto up = std::move(*it);
 	children.erase(it);
-	up->parent.reset();
+	reindexChildren(index);
+	this->invalidateAggregates();
+	this->bumpVersion();
+	this->markDirty();
+	if (auto* host = this->host()) host->onDetached(*up);
+	up->parent = nullptr;
+	up->child_index = 0;
 	return up;
 }
 
-UP<Hy3Node> Hy3GroupNode::extractChildRaw(Hy3Node& child) {
+std::unique_ptr<Hy3Node> Hy3GroupNode::extractChildRaw(Hy3Node& child) {
 	auto it = findChild(child);
 	if (it == children.end()) return nullptr;
 	return extractChildRaw(it);
 }
 
-UP<Hy3Node> Hy3GroupNode::extractChild(Hy3Node& child) {
+std::unique_ptr<Hy3Node> Hy3GroupNode::extractChild(Hy3Node& child) {
 	if (!child.is_root()) {
 		auto& actor = child.getExpandActor();
 		if (actor.is_group()) {
@@ -136,25 +166,59 @@ UP<Hy3Node> Hy3GroupNode::extractChild(Hy3Node& child) {
 	return extracted;
 }
 
-UP<Hy3Node> Hy3GroupNode::replaceChild(std::list<UP<Hy3Node>>::iterator it, UP<Hy3Node> replacement) {
-	replacement->parent = this->self;
+std::unique_ptr<Hy3Node>
+Hy3GroupNode::replaceChild(Hy3NodeList::iterator it, std::unique_ptr<Hy3Node> replacement) {
+	replacement->parent = this;
 	replacement->size_ratio = (*it)->size_ratio;
+	replacement->child_index = (*it)->child_index;
 	if (focused_child == it->get()) focused_child = replacement.get();
+
+	if (auto* host = this->host()) {
+		host->onDetached(**it);
+		host->onAttached(*replacement);
+	}
+
 	auto old = std::exchange(*it, std::move(replacement));
+	this->invalidateAggregates();
+	this->bumpVersion();
+	this->markDirty();
+	(*it)->markDirtyRecursive();
 	old->size_ratio = 1.0;
-	old->parent.reset();
+	old->parent = nullptr;
+	old->child_index = 0;
 	return old;
 }
 
+void Hy3GroupNode::moveChild(Hy3NodeList::iterator it, Hy3NodeList::iterator pos) {
+	auto from = it - children.begin();
+	auto to = pos - children.begin();
+
+	if (to > from) {
+		std::rotate(it, it + 1, pos);
+		reindexChildren(from);
+	} else if (to < from) {
+		std::rotate(pos, it, it + 1);
+		reindexChildren(to);
+	}
+
+	this->bumpVersion();
+	this->markDirty();
+}
+
 void Hy3GroupNode::collapseExpansions() {
 	if (this->expand_focused == ExpandFocusType::NotExpanded) return;
 	this->expand_focused = ExpandFocusType::NotExpanded;
+	this->markDirty();
 
 	Hy3Node* node = this->focused_child;
 
-	while (node->is_group() && node->as_group().expand_focused == ExpandFocusType::Stack) {
+	// a group emptied while expanded has no focused child
+	while (node != nullptr && node->is_group()
+	       && node->as_group().expand_focused == ExpandFocusType::Stack)
+	{
 		auto& group = node->as_group();
 		group.expand_focused = ExpandFocusType::NotExpanded;
+		group.markDirty();
 		node = group.focused_child;
 	}
 }
@@ -162,6 +226,9 @@ void Hy3GroupNode::collapseExpansions() {
 void Hy3GroupNode::setLayout(Hy3GroupLayout layout) {
 	if (layout == Hy3GroupLayout::Root) return; // root layout is immutable
 	this->layout = layout;
+	this->invalidateAggregates();
+	this->bumpVersion();
+	this->markDirty();
 
 	if (!isTab()) {
 		this->previous_nontab_layout = layout;
@@ -180,82 +247,35 @@ void Hy3GroupNode::setEphemeral(GroupEphemeralityOption ephemeral) {
 	}
 }
 
-bool Hy3Node::valid() const {
-	if (dynamic_cast<const Hy3GroupNode*>(this)) return true;
-	if (auto* t = dynamic_cast<const Hy3TargetNode*>(this)) return !t->target.expired();
-	return false;
-}
+bool Hy3Node::valid() {
+	switch (this->node_type) {
+	case Hy3NodeType::Group: return true;
+	case Hy3NodeType::Target: return static_cast<Hy3TargetNode*>(this)->alive();
+	}
 
-Hy3NodeType Hy3Node::type() const {
-	if (dynamic_cast<const Hy3GroupNode*>(this)) return Hy3NodeType::Group;
-	if (dynamic_cast<const Hy3TargetNode*>(this)) return Hy3NodeType::Target;
-	throw std::runtime_error("Attempted to get Hy3NodeType of uninitialized Hy3Node data");
+	return false;
 }
 
-bool Hy3Node::is_group() const { return dynamic_cast<const Hy3GroupNode*>(this) != nullptr; }
-
-bool Hy3Node::is_target() const { return dynamic_cast<const Hy3TargetNode*>(this) != nullptr; }
-
 Hy3GroupNode& Hy3Node::as_group() {
-	auto* gn = dynamic_cast<Hy3GroupNode*>(this);
-	if (!gn) throw std::runtime_error("Attempted to get group value of a non-group Hy3Node");
-	return *gn;
-}
-
-SP<Layout::ITarget> Hy3Node::as_target() {
-	auto* tn = dynamic_cast<Hy3TargetNode*>(this);
-	if (!tn) throw std::runtime_error("Attempted to get target value of a non-target Hy3Node");
-	if (tn->target.expired()) throw std::runtime_error("Attempted to upgrade an expired Hy3Node target");
-	return tn->target.lock();
+	if (!this->is_group())
+		throw std::runtime_error("Attempted to get group value of a non-group Hy3Node");
+	return *static_cast<Hy3GroupNode*>(this);
 }
 
-PHLWINDOW Hy3Node::as_window() {
-	return this->as_target()->window();
+Hy3TargetNode& Hy3Node::as_target_node() {
+	if (!this->is_target())
+		throw std::runtime_error("Attempted to get target value of a non-target Hy3Node");
+	return *static_cast<Hy3TargetNode*>(this);
 }
 
-UP<Hy3Node> Hy3Node::create(SP<Layout::ITarget> target) {
-	auto up = makeUnique<Hy3TargetNode>();
-	up->target = target;
-	UP<Hy3Node> result = std::move(up);
-	result->self = WP<Hy3Node>(result);
-	return result;
-}
-
-UP<Hy3Node> Hy3Node::create(Hy3GroupLayout group_layout) {
-	auto up = makeUnique<Hy3GroupNode>(group_layout);
-	UP<Hy3Node> result = std::move(up);
-	result->self = WP<Hy3Node>(result);
-	return result;
+std::unique_ptr<Hy3Node> Hy3GroupNode::create(Hy3NodePool& pool, Hy3GroupLayout layout) {
+	return std::unique_ptr<Hy3Node>(new (pool) Hy3GroupNode(layout));
 }
 
 bool Hy3Node::operator==(const Hy3Node& rhs) const { return this == &rhs; }
 
-void Hy3Node::focus(bool warp, Desktop::eFocusReason reason) {
-	this->markFocused();
-
-	g_pInputManager->unconstrainMouse();
-
-	switch (this->type()) {
-	case Hy3NodeType::Target: {
-		auto window = this->as_window();
-		window->setHidden(false);
-		Desktop::focusState()->fullWindowFocus(window, reason);
-		if (warp) Hy3Layout::warpCursorToBox(window->m_position, window->m_size);
-		break;
-	}
-	case Hy3NodeType::Group: {
-		Desktop::focusState()->resetWindowFocus();
-		for (auto& window: this->windows()) {
-			g_pCompositor->changeWindowZOrder(window.m_self.lock(), true);
-		}
-
-		if (warp) Hy3Layout::warpCursorToBox(this->visualBox.pos(), this->visualBox.size());
-		break;
-	}
-	}
-}
-
-void markGroupFocusedRecursive(Hy3GroupNode& group) {
+static void markGroupFocusedRecursive(Hy3GroupNode& group) {
+	if (!group.group_focused) group.version++;
 	group.group_focused = true;
 	for (auto& child: group.children) {
 		if (child->is_group()) markGroupFocusedRecursive(child->as_group());
@@ -264,6 +284,7 @@ void markGroupFocusedRecursive(Hy3GroupNode& group) {
 
 void Hy3Node::markFocused() {
 	auto* root = this->root();
+	auto& old_focus = root != nullptr ? root->getFocusedNode() : *this;
 
 	// update focus
 	if (this->is_group()) {
@@ -272,11 +293,20 @@ void Hy3Node::markFocused() {
 
 	for (auto& ancestor: this->ancestors()) {
 		auto& group = ancestor.parent->as_group();
+
+		// only tab and expanded groups move geometry when their focused child changes
+		if (group.focused_child != &ancestor
+		    && (group.isTab() || group.expand_focused != ExpandFocusType::NotExpanded))
+			group.markDirty();
+
 		group.focused_child = &ancestor;
 		group.group_focused = false;
 	}
 
-	root->updateDecos();
+	this->invalidateAggregates();
+	this->bumpVersion();
+
+	if (root != nullptr && root->tree_host != nullptr) root->tree_host->onFocusChanged(old_focus, *this);
 }
 
 Hy3Node& Hy3Node::getFocusedNode(bool ignore_group_focus, bool stop_at_expanded) {
@@ -324,34 +354,93 @@ Hy3Node& Hy3Node::getPlacementActor() {
 	return *this;
 }
 
-void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
-	// clang-format off
-	static const auto p_gaps_in = CConfigValue<Config::IComplexConfigValue>("general:gaps_in");
-	static const auto tab_bar_height = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:height");
-	static const auto tab_bar_padding = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:padding");
-	static const auto group_inset = CConfigValue<Config::INTEGER>("plugin:hy3:group_inset");
-	// clang-format on
+void Hy3Node::markDirty() {
+	this->geometry_dirty = true;
 
-	this->logicalBox = CBox(
-	    this->visualBox.x - offsets.x, this->visualBox.y - offsets.y,
-	    this->visualBox.w + offsets.x + offsets.w, this->visualBox.h + offsets.y + offsets.h
-	);
+	for (auto* node = this->parent; node != nullptr; node = node->parent) {
+		node->subtree_dirty = true;
+	}
+}
 
-	// Keep in sync with WindowTarget::updatePos
-	if (this->is_target()) {
-		this->as_window()->setHidden(this->hidden);
-		this->as_target()->setPositionGlobal({.logicalBox = this->logicalBox, .visualBox = this->visualBox});
-		// warp on hidden fixes bounding boxes for the tab click handler
-		if (no_animation || this->hidden) this->as_target()->warpPositionSize();
-		return;
+void Hy3Node::markDirtyRecursive() {
+	this->geometry_dirty = true;
+	this->subtree_dirty = true;
+	if (this->is_target()) this->as_target_node().committed.valid = false;
+
+	if (this->is_group()) {
+		for (auto& child: this->as_group().children) {
+			child->markDirtyRecursive();
+		}
 	}
+}
 
-	auto tpos = this->visualBox.pos();
-	auto tsize = this->visualBox.size();
+// Boxes closer than this are considered equal when deciding whether to push geometry.
+static bool boxesMatch(const Hy3Box& a, const Hy3Box& b) {
+	constexpr double tolerance = 0.01;
+	return std::abs(a.x - b.x) < tolerance && std::abs(a.y - b.y) < tolerance
+	    && std::abs(a.w - b.w) < tolerance && std::abs(a.h - b.h) < tolerance;
+}
 
-	auto& group = this->as_group();
-	auto workspace_rule = Config::workspaceRuleMgr()->getWorkspaceRuleFor(this->layout()->workspace());
-	auto gaps_in = workspace_rule.and_then([](auto r) { return r.m_gapsIn; }).value_or(*sc<Config::CCssGapData*>(p_gaps_in.ptr()));
+static size_t recalcNode(
+    Hy3Node& node,
+    Hy3Box offsets,
+    const Hy3GeometryParams& params,
+    Hy3TreeHost* host,
+    bool no_animation
+) {
+	// Skip subtrees that are neither dirty nor moved. A subtree that is only dirty below
+	// this node still has to be walked, but this node's own state is left alone.
+	auto moved = node.visualBox != node.last_visual_box || offsets != node.last_offsets
+	          || node.hidden != node.last_hidden;
+	auto self_dirty = moved || node.geometry_dirty;
+	if (!self_dirty && !node.subtree_dirty) return 0;
+
+	node.geometry_dirty = false;
+	node.subtree_dirty = false;
+	node.last_visual_box = node.visualBox;
+	node.last_offsets = offsets;
+	node.last_hidden = node.hidden;
+
+	size_t visited = 1;
+
+	node.logicalBox = Hy3Box {
+	    node.visualBox.x - offsets.x,
+	    node.visualBox.y - offsets.y,
+	    node.visualBox.w + offsets.x + offsets.w,
+	    node.visualBox.h + offsets.y + offsets.h,
+	};
+
+	if (node.is_target()) {
+		auto& target = node.as_target_node();
+		auto& committed = target.committed;
+
+		// pushing unchanged geometry still damages the window and may reconfigure the client
+		if (committed.valid && committed.hidden == node.hidden
+		    && boxesMatch(committed.logical, node.logicalBox)
+		    && boxesMatch(committed.visual, node.visualBox))
+		{
+			if (no_animation && !node.hidden) target.warpGeometry();
+			if (host) host->geometry_stats.skipped++;
+			return visited;
+		}
+
+		committed = {
+		    .valid = true,
+		    .hidden = node.hidden,
+		    .logical = node.logicalBox,
+		    .visual = node.visualBox,
+		};
+
+		if (host) host->geometry_stats.pushes++;
+
+		// warp on hidden fixes bounding boxes for the tab click handler
+		target.applyGeometry(node.logicalBox, node.visualBox, node.hidden, no_animation || node.hidden);
+		return visited;
+	}
+
+	auto& box = node.visualBox;
+	auto& gaps_in = params.gaps_in;
+	auto& group = node.as_group();
 
 	auto expand_focused = group.expand_focused != ExpandFocusType::NotExpanded;
 	bool directly_contains_expanded =
@@ -375,44 +464,40 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			hy3_log(
 			    ERR,
 			    "recalcSizePosRecursive: unable to find expansion target of latch node {:x}",
-			    (uintptr_t) this
+			    (uintptr_t) &node
 			);
 			errorNotif();
-			return;
+			return visited;
 		}
 
-		expanded_node->visualBox = CBox(tpos, tsize);
-		expanded_node->setHidden(this->hidden);
+		expanded_node->visualBox = box;
+		expanded_node->setHidden(node.hidden);
 
-		expanded_node->recalcSizePosRecursive(offsets, no_animation);
+		visited += recalcNode(*expanded_node, offsets, params, host, no_animation);
 	}
 
-	// Compute constraint for splits: total visible space minus inter-child gaps
 	double inter_gap = 0.0;
-	double constraint = 0.0;
+	double ratio_mul = 0.0;
 
 	switch (group.layout) {
 	case Hy3GroupLayout::SplitH:
-		inter_gap = gaps_in.m_left + gaps_in.m_right;
-		constraint = tsize.x - (child_count > 1 ? (child_count - 1) * inter_gap : 0);
+		inter_gap = gaps_in.left + gaps_in.right;
+		ratio_mul = splitRatioUnit(box.w, child_count, inter_gap);
 		break;
 	case Hy3GroupLayout::SplitV:
-		inter_gap = gaps_in.m_top + gaps_in.m_bottom;
-		constraint = tsize.y - (child_count > 1 ? (child_count - 1) * inter_gap : 0);
+		inter_gap = gaps_in.top + gaps_in.bottom;
+		ratio_mul = splitRatioUnit(box.h, child_count, inter_gap);
 		break;
 	case Hy3GroupLayout::Tabbed:
 	case Hy3GroupLayout::Root: break;
 	}
 
-	double ratio_mul =
-	    group.isSplit() ? child_count <= 0 ? 0 : constraint / child_count : 0;
-
 	double offset = 0;
 
 	for (auto& child: group.children) {
-		bool is_first = (child.get() == group.children.front().get());
-		bool is_last = (child.get() == group.children.back().get());
-		int inset = is_first && is_last && !this->is_root_group() ? *group_inset : 0;
+		bool is_first = child->child_index == 0;
+		bool is_last = child->child_index == child_count - 1;
+		int inset = is_first && is_last && !node.is_root_group() ? params.group_inset : 0;
 
 		if (directly_contains_expanded && child.get() == group.focused_child) {
 			// Advance offset past this child's visible share
@@ -423,48 +508,48 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			continue;
 		}
 
-		CBox child_offsets;
+		Hy3Box child_offsets;
 
 		switch (group.layout) {
 		case Hy3GroupLayout::SplitH: {
 			double child_w = child->size_ratio * ratio_mul;
 
-			child->visualBox = CBox(tpos.x + offset, tpos.y, child_w - inset, tsize.y);
-			child->hidden = this->hidden || expand_focused;
+			child->visualBox = Hy3Box {box.x + offset, box.y, child_w - inset, box.h};
+			child->hidden = node.hidden || expand_focused;
 
-			child_offsets.x = is_first ? offsets.x : gaps_in.m_left;
-			child_offsets.w = (is_last ? offsets.w : gaps_in.m_right) + inset;
+			child_offsets.x = is_first ? offsets.x : gaps_in.left;
+			child_offsets.w = (is_last ? offsets.w : gaps_in.right) + inset;
 			child_offsets.y = offsets.y;
 			child_offsets.h = offsets.h;
 
 			offset += child_w;
 			if (!is_last) offset += inter_gap;
 
-			child->recalcSizePosRecursive(child_offsets, no_animation);
+			visited += recalcNode(*child, child_offsets, params, host, no_animation);
 			break;
 		}
 		case Hy3GroupLayout::SplitV: {
 			double child_h = child->size_ratio * ratio_mul;
 
-			child->visualBox = CBox(tpos.x, tpos.y + offset, tsize.x, child_h - inset);
-			child->hidden = this->hidden || expand_focused;
+			child->visualBox = Hy3Box {box.x, box.y + offset, box.w, child_h - inset};
+			child->hidden = node.hidden || expand_focused;
 
-			child_offsets.y = (is_first ? offsets.y : gaps_in.m_top) + inset;
-			child_offsets.h = is_last ? offsets.h : gaps_in.m_bottom;
+			child_offsets.y = (is_first ? offsets.y : gaps_in.top) + inset;
+			child_offsets.h = is_last ? offsets.h : gaps_in.bottom;
 			child_offsets.x = offsets.x;
 			child_offsets.w = offsets.w;
 
 			offset += child_h;
 			if (!is_last) offset += inter_gap;
 
-			child->recalcSizePosRecursive(child_offsets, no_animation);
+			visited += recalcNode(*child, child_offsets, params, host, no_animation);
 			break;
 		}
 		case Hy3GroupLayout::Tabbed: {
-			double tab_offset = (double)*tab_bar_height + (double)*tab_bar_padding;
+			double tab_offset = params.tab_offset;
 
-			child->visualBox = CBox(tpos.x, tpos.y + tab_offset, tsize.x, tsize.y - tab_offset);
-			child->hidden = this->hidden || expand_focused || group.focused_child != child.get();
+			child->visualBox = Hy3Box {box.x, box.y + tab_offset, box.w, box.h - tab_offset};
+			child->hidden = node.hidden || expand_focused || group.focused_child != child.get();
 
 			// Tab bar makes child non-edge on top
 			child_offsets.x = offsets.x;
@@ -472,106 +557,112 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			child_offsets.w = offsets.w;
 			child_offsets.h = offsets.h;
 
-			child->recalcSizePosRecursive(child_offsets, no_animation);
+			visited += recalcNode(*child, child_offsets, params, host, no_animation);
 			break;
 		}
 		case Hy3GroupLayout::Root: {
-			child->visualBox = CBox(tpos, tsize);
-			child->hidden = this->hidden;
-			child->recalcSizePosRecursive(offsets, no_animation);
+			child->visualBox = box;
+			child->hidden = node.hidden;
+			visited += recalcNode(*child, offsets, params, host, no_animation);
 			break;
 		}
 		}
 	}
 
-	this->updateTabBar(no_animation);
+	if (self_dirty && host) host->onGroupGeometry(group, no_animation);
+	return visited;
 }
 
-// Find the visible window with the highest z-order in this subtree.
-static CWindow* findTopVisibleWindow(Hy3Node& node) {
-	CWindow* result = nullptr;
-	auto& compositor_windows = g_pCompositor->m_windows;
-	auto it = compositor_windows.begin();
-	for (auto& window: node.windows(true)) {
-		for (auto search = it; search != compositor_windows.end(); ++search) {
-			if (search->get() == &window) {
-				result = &window;
-				it = search;
-				break;
-			}
-		}
-	}
-	return result;
+size_t Hy3Node::recalcSizePosRecursive(
+    Hy3Box offsets,
+    const Hy3GeometryParams& params,
+    bool no_animation
+) {
+	return recalcNode(*this, offsets, params, this->host(), no_animation);
 }
 
-void Hy3Node::updateTabBar(bool no_animation) {
-	if (this->type() == Hy3NodeType::Group) {
+std::string Hy3Node::getTitle() {
+	switch (this->type()) {
+	case Hy3NodeType::Target: return this->as_target_node().title();
+	case Hy3NodeType::Group:
 		auto& group = this->as_group();
-
-		if (group.isTab()) {
-			if (!group.tab_bar) group.tab_bar = Hy3TabGroup::create(*this);
-			group.tab_bar->updateWithGroup(*this, no_animation);
-
-			auto top_window = findTopVisibleWindow(*this);
-			group.tab_bar->target_window = top_window ? top_window->m_self.lock() : nullptr;
-			if (top_window != nullptr) group.tab_bar->workspace = top_window->m_workspace;
-		} else if (group.tab_bar) {
-			group.tab_bar.release();
-		}
+		group.updateAggregates();
+		return group.aggregates.title;
 	}
-}
 
-void Hy3Node::updateTabBarRecursive() {
-	for (auto& node: this->ancestors()) {
-		node.updateTabBar();
-	}
+	return "";
 }
 
-void Hy3Node::updateDecos() {
+bool Hy3Node::isUrgent() {
 	switch (this->type()) {
-	case Hy3NodeType::Target:
-		this->as_window()->updateDecorationValues();
-		break;
+	case Hy3NodeType::Target: return this->as_target_node().urgent();
 	case Hy3NodeType::Group:
-		for (auto& child: this->as_group().children) {
-			child->updateDecos();
-		}
-
-		this->updateTabBar();
+		auto& group = this->as_group();
+		group.updateAggregates();
+		return group.aggregates.urgent;
 	}
+
+	return false;
 }
 
-std::string Hy3Node::getTitle() {
+size_t Hy3Node::windowCount() {
 	switch (this->type()) {
-	case Hy3NodeType::Target: return this->as_window()->m_title;
+	case Hy3NodeType::Target: return 1;
 	case Hy3NodeType::Group:
-		std::string title;
 		auto& group = this->as_group();
+		group.updateAggregates();
+		return group.aggregates.window_count;
+	}
 
-		switch (group.layout) {
-		case Hy3GroupLayout::Root: title = "[R] "; break;
-		case Hy3GroupLayout::SplitH: title = "[H] "; break;
-		case Hy3GroupLayout::SplitV: title = "[V] "; break;
-		case Hy3GroupLayout::Tabbed: title = "[T] "; break;
-		}
+	return 0;
+}
 
-		if (group.focused_child == nullptr) {
-			title += "Group";
-		} else {
-			title += group.focused_child->getTitle();
-		}
+void Hy3Node::invalidateAggregates() {
+	auto* node = this->is_group() ? this : this->parent;
 
-		return title;
+	while (node != nullptr) {
+		auto& group = node->as_group();
+		if (!group.aggregates.valid) break;
+		group.aggregates.valid = false;
+		node = node->parent;
 	}
+}
 
-	return "";
+void Hy3Node::bumpVersion() {
+	auto* node = this->is_group() ? this : this->parent;
+
+	while (node != nullptr) {
+		node->as_group().version++;
+		node = node->parent;
+	}
 }
 
-bool Hy3Node::isUrgent() {
-	for (auto& window: this->windows()) {
-		if (window.m_isUrgent) return true;
+void Hy3GroupNode::updateAggregates() {
+	auto& cache = this->aggregates;
+	if (cache.valid) return;
+
+	cache.urgent = false;
+	cache.window_count = 0;
+
+	for (auto& child: this->children) {
+		cache.urgent |= child->isUrgent();
+		cache.window_count += child->windowCount();
 	}
-	return false;
+
+	switch (this->layout) {
+	case Hy3GroupLayout::Root: cache.title = "[R] "; break;
+	case Hy3GroupLayout::SplitH: cache.title = "[H] "; break;
+	case Hy3GroupLayout::SplitV: cache.title = "[V] "; break;
+	case Hy3GroupLayout::Tabbed: cache.title = "[T] "; break;
+	}
+
+	if (this->focused_child == nullptr) {
+		cache.title += "Group";
+	} else {
+		cache.title += this->focused_child->getTitle();
+	}
+
+	cache.valid = true;
 }
 
 void Hy3Node::setHidden(bool hidden) {
@@ -584,73 +675,97 @@ void Hy3Node::setHidden(bool hidden) {
 	}
 }
 
-Hy3Node* Hy3Node::findNodeForTabGroup(Hy3TabGroup& tab_group) {
-	if (this->is_group()) {
-		if (this->hidden) return nullptr;
-		auto& group = this->as_group();
+Hy3AncestorRange Hy3Node::ancestors() { return Hy3AncestorRange {.start = this}; }
 
-		if (group.isTab() && group.tab_bar.get() == &tab_group) {
-			return this;
-		}
+Hy3TargetRange Hy3Node::targets(bool visible_only) {
+	return Hy3TargetRange {.root = this, .visible_only = visible_only};
+}
 
-		for (auto& node: group.children) {
-			auto* r = node->findNodeForTabGroup(tab_group);
-			if (r != nullptr) return r;
-		}
-	} else return nullptr;
+Hy3AncestorRange::iterator::iterator(Hy3Node* node): node(node) {
+	if (this->node != nullptr && this->node->is_root()) this->node = nullptr;
+}
 
-	return nullptr;
+Hy3AncestorRange::iterator& Hy3AncestorRange::iterator::operator++() {
+	auto* parent = this->node->parent;
+	this->node = parent == nullptr || parent->is_root() ? nullptr : parent;
+	return *this;
 }
 
-std::generator<Hy3Node&> Hy3Node::ancestors() {
-	auto* node = this;
-	while (!node->is_root()) {
-		co_yield *node;
-		node = node->parent.get();
-	}
+Hy3AncestorRange::iterator Hy3AncestorRange::iterator::operator++(int) {
+	auto it = *this;
+	++*this;
+	return it;
 }
 
-std::generator<CWindow&> Hy3Node::windows(bool visibleOnly) {
-	if (this->is_target()) {
-		co_yield *this->as_window();
-	} else {
-		auto& group = this->as_group();
-		if (visibleOnly
-		    && (group.isTab()
-		        || group.expand_focused != ExpandFocusType::NotExpanded))
-		{
-			if (group.focused_child != nullptr) {
-				for (auto& window: group.focused_child->windows(true)) {
-					co_yield window;
-				}
-			}
-		} else {
-			for (auto& child: group.children) {
-				for (auto& window: child->windows(visibleOnly)) {
-					co_yield window;
-				}
-			}
+Hy3TargetRange::iterator::iterator(Hy3Node* root, bool visible_only)
+    : root(root)
+    , visible_only(visible_only) {
+	this->node = this->findTarget(root);
+}
+
+Hy3TargetNode& Hy3TargetRange::iterator::operator*() const { return this->node->as_target_node(); }
+
+Hy3TargetRange::iterator& Hy3TargetRange::iterator::operator++() {
+	this->node = this->findTarget(this->nextNode(this->node));
+	return *this;
+}
+
+Hy3TargetRange::iterator Hy3TargetRange::iterator::operator++(int) {
+	auto it = *this;
+	++*this;
+	return it;
+}
+
+// Only the focused child of tab and expanded groups is visible.
+bool Hy3TargetRange::iterator::restricted(Hy3GroupNode& group) const {
+	return this->visible_only
+	    && (group.isTab() || group.expand_focused != ExpandFocusType::NotExpanded);
+}
+
+Hy3Node* Hy3TargetRange::iterator::firstChild(Hy3GroupNode& group) const {
+	if (this->restricted(group)) return group.focused_child;
+	return group.children.empty() ? nullptr : group.children.front().get();
+}
+
+// The node following `node` in depth first order once its subtree has been visited.
+Hy3Node* Hy3TargetRange::iterator::nextNode(Hy3Node* node) const {
+	while (node != this->root) {
+		auto& parent = node->parent->as_group();
+		if (!this->restricted(parent) && node->child_index + 1 < parent.children.size()) {
+			return parent.children[node->child_index + 1].get();
 		}
+
+		node = &parent;
 	}
+
+	return nullptr;
 }
 
+// The first target node at or after `node` in depth first order.
+Hy3Node* Hy3TargetRange::iterator::findTarget(Hy3Node* node) const {
+	while (node != nullptr && !node->is_target()) {
+		auto* child = this->firstChild(node->as_group());
+		node = child != nullptr ? child : this->nextNode(node);
+	}
+
+	return node;
+}
 
 std::string Hy3Node::debugNode() {
 	std::stringstream buf;
 	std::string addr = "0x" + std::to_string((size_t) this);
 	switch (this->type()) {
 	case Hy3NodeType::Target:
-		buf << "window(" << this << " of " << this->parent.get() << ") [hypr " << this->as_window().get() << "] size ratio: " << this->size_ratio;
+		buf << "window(" << this << " of " << this->parent << ") [" << this->as_target_node().describe() << "] size ratio: " << this->size_ratio;
 		break;
 	case Hy3NodeType::Group:
-		buf << "group(" << this << " of " << this->parent.get() << ") [";
+		buf << "group(" << this << " of " << this->parent << ") [";
 
 		auto& group = this->as_group();
 		switch (group.layout) {
 		case Hy3GroupLayout::Root: {
-			auto* l = this->layout();
-			auto ws = l ? l->workspace() : nullptr;
-			buf << "root " << (ws ? ws->m_id : -1);
+			auto* host = group.tree_host;
+			buf << "root " << (host ? host->describe() : "");
 			break;
 		}
 		case Hy3GroupLayout::SplitH: buf << "splith"; break;
@@ -660,6 +775,7 @@ std::string Hy3Node::debugNode() {
 
 		buf << "] size ratio: ";
 		buf << this->size_ratio;
+		buf << ", windows: " << this->windowCount();
 
 		if (group.expand_focused != ExpandFocusType::NotExpanded) {
 			buf << ", has-expanded";
@@ -712,7 +828,7 @@ static bool shouldCollapseNode(Hy3Node* node, CollapsePolicy policy) {
 }
 
 static void collapseSingleParentInternal(Hy3Node* into) {
-	auto* parent = into->parent.get();
+	auto* parent = into->parent;
 	auto& parentGroup = parent->as_group();
 	auto it = parentGroup.findChild(*into);
 	auto& intoGroup = into->as_group();
@@ -728,12 +844,7 @@ static void collapseSingleParentInternal(Hy3Node* into) {
 	auto* child = childUp.get();
 	auto old = parentGroup.replaceChild(it, std::move(childUp));
 
-	// HACK: steal titlebar from parent if we have a new node, prevents visual issues if rewrapped
-	if (child->is_group() && old->as_group().isTab() && child->as_group().isTab()) {
-		auto& n = child->as_group().tab_bar;
-		auto& o = old->as_group().tab_bar;
-		if (n->bar.entries.empty() || n->bar.entries.front().vertical_pos->value() == 1) n = std::move(o);
-	}
+	if (auto* host = parent->host()) host->onGroupCollapsed(old->as_group(), *child);
 }
 
 Hy3Node* Hy3Node::collapseParents(CollapsePolicy policy) {
@@ -747,7 +858,7 @@ Hy3Node* Hy3Node::collapseParents(CollapsePolicy policy) {
 	auto& group = this->as_group();
 
 	if (group.children.empty()) {
-		auto* p = this->parent.get();
+		auto* p = this->parent;
 		Hy3Node* merged = nullptr;
 		p->extractAndMerge(*this, &merged, CollapsePolicy::InvalidOnly);
 		return merged;
@@ -755,7 +866,7 @@ Hy3Node* Hy3Node::collapseParents(CollapsePolicy policy) {
 
 	hy3_log(LOG, "ShouldCollapse {:x} policy {}: {}", (uintptr_t)this, (int)policy, shouldCollapseNode(this, policy));
 	if (shouldCollapseNode(this, policy)) {
-		auto* parent_node = this->parent.get();
+		auto* parent_node = this->parent;
 		collapseSingleParentInternal(this);
 		return parent_node->collapseParents(CollapsePolicy::InvalidOnly);
 	} else {
@@ -765,11 +876,85 @@ Hy3Node* Hy3Node::collapseParents(CollapsePolicy policy) {
 	return this;
 }
 
-UP<Hy3Node> Hy3Node::extractAndMerge(
+void Hy3Node::checkInvariants(
+    std::vector<std::string>& errors,
+    std::vector<Hy3TargetNode*>& targets,
+    bool dirty_only
+) {
+	if (dirty_only && !this->geometry_dirty && !this->subtree_dirty) return;
+
+	if (this->is_target()) {
+		targets.push_back(&this->as_target_node());
+		return;
+	}
+
+	auto& group = this->as_group();
+	double ratio_sum = 0;
+
+	for (size_t i = 0; i < group.children.size(); i++) {
+		auto* child = group.children[i].get();
+		if (child == nullptr) {
+			errors.push_back(std::format("group {:x} has a null child at {}", (uintptr_t) this, i));
+			continue;
+		}
+
+		if (child->parent != this)
+			errors.push_back(std::format(
+			    "child {:x} of group {:x} has parent {:x}",
+			    (uintptr_t) child,
+			    (uintptr_t) this,
+			    (uintptr_t) child->parent
+			));
+
+		if (child->child_index != i)
+			errors.push_back(
+			    std::format("child {:x} is at index {} but has child_index {}", (uintptr_t) child, i, child->child_index)
+			);
+
+		ratio_sum += child->size_ratio;
+		child->checkInvariants(errors, targets, dirty_only);
+	}
+
+	if (group.children.empty()) {
+		if (!this->is_root()) errors.push_back(std::format("group {:x} is empty", (uintptr_t) this));
+		return;
+	}
+
+	if (group.focused_child == nullptr)
+		errors.push_back(std::format("group {:x} has no focused child", (uintptr_t) this));
+	else if (group.findChild(*group.focused_child) == group.children.end())
+		errors.push_back(std::format(
+		    "focused child {:x} of group {:x} is not one of its children",
+		    (uintptr_t) group.focused_child,
+		    (uintptr_t) this
+		));
+
+	if (std::abs(ratio_sum - group.children.size()) > 0.01)
+		errors.push_back(std::format(
+		    "size ratios of group {:x} sum to {} instead of {}",
+		    (uintptr_t) this,
+		    ratio_sum,
+		    group.children.size()
+		));
+
+	// Groups left with a single child are not checked, they are collapsed lazily by the next
+	// extraction. changegroup on a tab group holding a split leaves a split in a split. See
+	// checkCollapsed.
+}
+
+void Hy3Node::checkCollapsed(std::vector<std::string>& errors) {
+	for (auto* node = this; node != nullptr; node = node->parent) {
+		if (node->is_group() && shouldCollapseNode(node, CollapsePolicy::InvalidOnly))
+			errors.push_back(std::format("group {:x} was not collapsed", (uintptr_t) node));
+	}
+}
+
+std::unique_ptr<Hy3Node> Hy3Node::extractAndMerge(
     Hy3Node& child,
     Hy3Node** out_parent,
     CollapsePolicy policy
 ) {
+	Hy3PerfScope perf(Hy3PerfOp::ExtractAndMerge);
 	hy3_log(
 	    TRACE,
 	    "extractAndMerge: extracting {:x} from {:x}",
@@ -797,32 +982,38 @@ UP<Hy3Node> Hy3Node::extractAndMerge(
 }
 
 void Hy3Node::insertAndMerge(
-    std::list<UP<Hy3Node>>::iterator pos,
-    UP<Hy3Node> child,
+    Hy3NodeList::iterator pos,
+    std::unique_ptr<Hy3Node> child,
     CollapsePolicy policy
 ) {
 	this->as_group().insertChild(pos, std::move(child));
 	this->collapseParents(policy);
 }
 
-void Hy3Node::insertAndMerge(UP<Hy3Node> child, CollapsePolicy policy) {
+void Hy3Node::insertAndMerge(std::unique_ptr<Hy3Node> child, CollapsePolicy policy) {
 	this->as_group().insertChild(std::move(child));
 	this->collapseParents(policy);
 }
 
 void Hy3Node::wrap(Hy3GroupLayout layout, GroupEphemeralityOption ephemeral, bool change) {
+	auto* host = this->host();
+	if (host == nullptr) {
+		hy3_log(ERR, "wrap called on node {:x} outside of a hosted tree", (uintptr_t) this);
+		return;
+	}
+
 	auto& parentGroup = this->parent->as_group();
 	if (change && !this->parent->is_root() && parentGroup.children.size() == 1) {
 		parentGroup.setLayout(layout);
 		parentGroup.setEphemeral(ephemeral);
-		this->layout()->recalcGeometry();
-		this->parent->updateTabBarRecursive();
+		host->recalcGeometry();
+		host->refreshTabBars(*this->parent);
 		return;
 	}
 
 	auto it = parentGroup.findChild(*this);
 
-	auto group_up = Hy3Node::create(layout);
+	auto group_up = host->createGroup(layout);
 	auto& group_node = *group_up;
 
 	auto this_up = parentGroup.replaceChild(it, std::move(group_up));
@@ -835,8 +1026,8 @@ void Hy3Node::wrap(Hy3GroupLayout layout, GroupEphemeralityOption ephemeral, boo
 	    || ephemeral == GroupEphemeralityOption::ForceEphemeral)
 		group.setEphemeral(GroupEphemeralityOption::ForceEphemeral);
 
-	this->layout()->recalcGeometry();
-	group_node.updateTabBarRecursive();
+	host->recalcGeometry();
+	host->refreshTabBars(group_node);
 }
 
 
@@ -916,37 +1107,42 @@ int directionToIteratorIncrement(ShiftDirection direction) {
 }
 
 void Hy3Node::resize(ShiftDirection direction, double delta, bool no_animation) {
-	auto* parent_node = this->parent.get();
+	auto* parent_node = this->parent;
 	auto& containing_group = parent_node->as_group();
+	auto* host = this->host();
+	if (host) host->flushGeometry();
 
 	if (containing_group.isSplit()
 	    && getAxis(direction) == getAxis(containing_group.layout))
 	{
 		double parent_size =
 		    getAxis(direction) == Axis::Horizontal ? parent_node->visualBox.w : parent_node->visualBox.h;
-		auto ratio_mod = delta * (float) containing_group.children.size() / parent_size;
 
 		const auto end_of_children = containing_group.children.end();
 		auto iter = containing_group.findChild(*this);
 
-		if (iter != end_of_children) {
-			const auto outermost_node_in_group = getOuterChild(containing_group, direction);
-			if (this != outermost_node_in_group) {
-				auto inc = directionToIteratorIncrement(direction);
-				iter = std::next(iter, inc);
-				ratio_mod *= inc;
-			}
+		// the outermost child has no neighbor to take the space from
+		if (iter != end_of_children && this != getOuterChild(containing_group, direction)) {
+			auto inc = directionToIteratorIncrement(direction);
+			iter = std::next(iter, inc);
+			delta *= inc;
 
 			if (iter != end_of_children) {
 				auto* neighbor = iter->get();
-				auto requested_size_ratio = this->size_ratio + ratio_mod;
-				auto requested_neighbor_size_ratio = neighbor->size_ratio - ratio_mod;
-
-				if (requested_size_ratio >= MIN_RATIO && requested_neighbor_size_ratio >= MIN_RATIO) {
-					this->size_ratio = requested_size_ratio;
-					neighbor->size_ratio = requested_neighbor_size_ratio;
-
-					this->layout()->recalcGeometry(no_animation);
+				auto ratios = resizedSplitRatios(
+				    this->size_ratio,
+				    neighbor->size_ratio,
+				    delta,
+				    containing_group.children.size(),
+				    parent_size
+				);
+
+				if (ratios) {
+					this->size_ratio = ratios->first;
+					neighbor->size_ratio = ratios->second;
+					containing_group.markDirty();
+
+					if (host) host->recalcGeometry(no_animation);
 				}
 			}
 		}
@@ -3,17 +3,24 @@
 struct Hy3Node;
 struct Hy3TargetNode;
 struct Hy3GroupNode;
-struct Hy3RootNode;
-enum class Hy3GroupLayout;
+class Hy3TreeHost;
 
-#include <generator>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
 
-#include <hyprland/src/defines.hpp>
-#include <hyprland/src/desktop/view/Window.hpp>
-#include <hyprland/src/layout/target/Target.hpp>
+#include "NodePool.hpp"
+#include "geometry.hpp"
 
-#include "Hy3Layout.hpp"
-#include "TabGroup.hpp"
+// The node tree. Free of hyprland types so it is part of hy3core: targets are
+// implemented by subclasses of Hy3TargetNode, and everything the tree cannot do by
+// itself (indexing, tab bars, scheduling geometry passes) goes through the
+// Hy3TreeHost set on its root node.
+
+using Hy3NodeList = std::vector<std::unique_ptr<Hy3Node>>;
 
 enum class Hy3GroupLayout {
 	Root,
@@ -22,7 +29,7 @@ enum class Hy3GroupLayout {
 	Tabbed,
 };
 
-enum class Hy3NodeType {
+enum class Hy3NodeType : uint8_t {
 	Target,
 	Group,
 };
@@ -45,41 +52,188 @@ enum class CollapsePolicy {
 	SingleNodeGroups,
 };
 
+enum class GroupEphemeralityOption {
+	Ephemeral,
+	Standard,
+	ForceEphemeral,
+};
+
+enum class ShiftDirection {
+	Left,
+	Up,
+	Down,
+	Right,
+};
+
+inline static constexpr char getShiftDirectionChar(ShiftDirection direction) {
+	return direction == ShiftDirection::Left ? 'l'
+	     : direction == ShiftDirection::Up   ? 'u'
+	     : direction == ShiftDirection::Down ? 'd'
+	                                         : 'r';
+}
+
+enum class Axis { None, Horizontal, Vertical };
+
+// Weak reference to a node, reads as null once the node is destroyed.
+class Hy3NodeRef {
+public:
+	Hy3NodeRef() = default;
+
+	Hy3Node* get() const;
+	Hy3Node* operator->() const { return this->get(); }
+	explicit operator bool() const { return this->get() != nullptr; }
+
+private:
+	std::weak_ptr<Hy3Node* const> ref;
+
+	friend struct Hy3Node;
+};
+
+// Walks from a node up to, but not including, the root node.
+struct Hy3AncestorRange {
+	class iterator {
+	public:
+		using value_type = Hy3Node;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+		explicit iterator(Hy3Node* node);
+
+		Hy3Node& operator*() const { return *this->node; }
+		iterator& operator++();
+		iterator operator++(int);
+		bool operator==(std::default_sentinel_t) const { return this->node == nullptr; }
+
+	private:
+		Hy3Node* node = nullptr;
+	};
+
+	Hy3Node* start;
+
+	iterator begin() const { return iterator(this->start); }
+	std::default_sentinel_t end() const { return {}; }
+};
+
+// Walks the targets of a subtree in depth first order without allocating, using the
+// parent links and child indices of the nodes instead of an explicit stack.
+struct Hy3TargetRange {
+	class iterator {
+	public:
+		using value_type = Hy3TargetNode;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+		iterator(Hy3Node* root, bool visible_only);
+
+		Hy3TargetNode& operator*() const;
+		iterator& operator++();
+		iterator operator++(int);
+		bool operator==(std::default_sentinel_t) const { return this->node == nullptr; }
+
+	private:
+		Hy3Node* root = nullptr;
+		Hy3Node* node = nullptr;
+		bool visible_only = false;
+
+		bool restricted(Hy3GroupNode& group) const;
+		Hy3Node* firstChild(Hy3GroupNode& group) const;
+		Hy3Node* nextNode(Hy3Node* node) const;
+		Hy3Node* findTarget(Hy3Node* node) const;
+	};
+
+	Hy3Node* root;
+	bool visible_only;
+
+	iterator begin() const { return iterator(this->root, this->visible_only); }
+	std::default_sentinel_t end() const { return {}; }
+};
+
+struct Hy3GeometryStats {
+	// geometry pushes to targets, and pushes skipped because nothing changed
+	size_t pushes = 0;
+	size_t skipped = 0;
+	// geometry pass requests merged into an already scheduled pass
+	size_t coalesced = 0;
+};
+
+// Side effects of tree operations that depend on what displays the tree. Set on the
+// root node of a tree as Hy3GroupNode::tree_host.
+class Hy3TreeHost {
+public:
+	virtual ~Hy3TreeHost() = default;
+
+	virtual Hy3NodePool& nodePool() = 0;
+	// Create an empty group for operations that add groups to the tree, such as wrap.
+	virtual std::unique_ptr<Hy3Node> createGroup(Hy3GroupLayout layout);
+	// Called once a subtree was attached to the tree, and before one is detached.
+	virtual void onAttached(Hy3Node&) {}
+	virtual void onDetached(Hy3Node&) {}
+	// Called by Hy3Node::markFocused once `focus` replaced `old_focus`.
+	virtual void onFocusChanged(Hy3Node& old_focus, Hy3Node& focus) {}
+	// Called when `group` is about to be replaced by its only child.
+	virtual void onGroupCollapsed(Hy3GroupNode& group, Hy3Node& child) {}
+	// Called by the geometry pass for every group it moved or that was marked dirty.
+	virtual void onGroupGeometry(Hy3GroupNode& group, bool no_animation) {}
+	// Refresh the tab bars showing `node` and its ancestors outside of a geometry pass.
+	virtual void refreshTabBars(Hy3Node& node) {}
+	// Schedule a geometry pass. Repeated calls may be coalesced.
+	virtual void recalcGeometry(bool no_animation = false) = 0;
+	// Run a scheduled geometry pass now, for operations that read node geometry.
+	virtual void flushGeometry() = 0;
+	// shown next to the root node by Hy3Node::debugNode
+	virtual std::string describe() { return ""; }
+
+	Hy3GeometryStats geometry_stats;
+};
+
 struct Hy3Node {
-	WP<Hy3Node> parent;
-	WP<Hy3Node> self; // set from owning UP at creation time
-	CBox logicalBox;
-	CBox visualBox;
+	Hy3Node* parent = nullptr;
+	Hy3Box logicalBox;
+	Hy3Box visualBox;
 	float size_ratio = 1.0;
+	// position in parent->children, maintained by Hy3GroupNode
+	size_t child_index = 0;
 	bool hidden = false;
 
+	// geometry must be recalculated even if the inputs below are unchanged
+	bool geometry_dirty = true;
+	// a descendant has geometry_dirty set
+	bool subtree_dirty = false;
+	// inputs of the last geometry recalculation
+	Hy3Box last_visual_box;
+	Hy3Box last_offsets;
+	bool last_hidden = false;
+	// set once by the concrete node type, used instead of RTTI for type checks and casts
+	const Hy3NodeType node_type;
+	// Never reused. Pooled nodes reuse the address of the last freed node, so state that
+	// can outlive a node identifies it by id instead of by pointer.
+	const uint64_t id;
+
 	virtual ~Hy3Node() = default;
 	Hy3Node(const Hy3Node&) = delete;
 	Hy3Node& operator=(const Hy3Node&) = delete;
 
-	template<typename T> bool is() const { return dynamic_cast<const T*>(this) != nullptr; }
-	template<typename T> T& as() { return dynamic_cast<T&>(*this); }
-	template<typename T> const T& as() const { return dynamic_cast<const T&>(*this); }
-
-	bool valid() const;
-	Hy3NodeType type() const;
-	bool is_target() const;
-	bool is_group() const;
+	bool valid();
+	Hy3NodeType type() const { return this->node_type; }
+	bool is_target() const { return this->node_type == Hy3NodeType::Target; }
+	bool is_group() const { return this->node_type == Hy3NodeType::Group; }
 	Hy3GroupNode& as_group();
-	SP<Layout::ITarget> as_target();
-	PHLWINDOW as_window();
+	Hy3TargetNode& as_target_node();
 
 	bool operator==(const Hy3Node&) const;
 	bool is_root();
 	bool is_root_group();
 	void assertNotRoot();
-	Hy3RootNode* root();
-	Hy3Layout* layout();
+	Hy3GroupNode* root();
+	Hy3TreeHost* host();
+	Hy3NodeRef ref();
 
-	static UP<Hy3Node> create(SP<Layout::ITarget> target);
-	static UP<Hy3Node> create(Hy3GroupLayout group_layout);
+	// nodes are allocated from their layout's Hy3NodePool. see NodePool.hpp
+	static void* operator new(size_t size) { return Hy3NodePool::allocateUnpooled(size); }
+	static void* operator new(size_t size, Hy3NodePool& pool) { return pool.allocate(size); }
+	static void operator delete(void* ptr) { Hy3NodePool::deallocate(ptr); }
+	static void operator delete(void* ptr, Hy3NodePool&) { Hy3NodePool::deallocate(ptr); }
 
-	void focus(bool warp, Desktop::eFocusReason reason);
 	void markFocused();
 	Hy3Node& getFocusedNode(bool ignore_group_focus = false, bool stop_at_expanded = false);
 	Hy3Node* findNeighbor(ShiftDirection);
@@ -89,59 +243,125 @@ struct Hy3Node {
 	Hy3Node& getExpandActor();
 	Hy3Node& getPlacementActor();
 
-	void recalcSizePosRecursive(CBox offsets, bool no_animation = false);
-	void updateTabBar(bool no_animation = false);
-	void updateTabBarRecursive();
-	void updateDecos();
+	// Returns the number of nodes that were recalculated.
+	size_t recalcSizePosRecursive(
+	    Hy3Box offsets,
+	    const Hy3GeometryParams& params,
+	    bool no_animation = false
+	);
+	void markDirty();
+	void markDirtyRecursive();
 
 	std::string getTitle();
 	bool isUrgent();
+	size_t windowCount();
+	// Invalidate the cached aggregates of this node's group and every group above it.
+	// Must be called whenever children, focused_child, the group layout, or the title or
+	// urgency of a window in the subtree changes.
+	void invalidateAggregates();
+	// Bump the version of this node's group and every group above it. Must be called
+	// whenever children, focus or the group layout change.
+	void bumpVersion();
 	void setHidden(bool);
 
-	Hy3Node* findNodeForTabGroup(Hy3TabGroup&);
-	std::generator<Hy3Node&> ancestors();
-	std::generator<Desktop::View::CWindow&> windows(bool visibleOnly = false);
+	Hy3AncestorRange ancestors();
+	Hy3TargetRange targets(bool visible_only = false);
 	std::string debugNode();
+	// Append a description of every broken tree invariant in this subtree to `errors`, and
+	// every target node that was checked to `targets`. With `dirty_only` set, only nodes
+	// marked dirty since the last geometry pass, and the groups above them, are checked.
+	void checkInvariants(
+	    std::vector<std::string>& errors,
+	    std::vector<Hy3TargetNode*>& targets,
+	    bool dirty_only = false
+	);
+	// Append every group from this node up to the root that collapseParents with
+	// CollapsePolicy::InvalidOnly would still remove. Holds for the node returned by
+	// collapseParents, groups elsewhere in the tree are collapsed lazily.
+	void checkCollapsed(std::vector<std::string>& errors);
 
 	Hy3Node* collapseParents(CollapsePolicy policy);
-	UP<Hy3Node> extractAndMerge(
+	std::unique_ptr<Hy3Node> extractAndMerge(
 	    Hy3Node& child,
 	    Hy3Node** out_parent = nullptr,
 	    CollapsePolicy policy = CollapsePolicy::EmptySplits
 	);
 
 	void insertAndMerge(
-	    std::list<UP<Hy3Node>>::iterator pos,
-	    UP<Hy3Node> child,
+	    Hy3NodeList::iterator pos,
+	    std::unique_ptr<Hy3Node> child,
 	    CollapsePolicy policy = CollapsePolicy::EmptySplits
 	);
-	void insertAndMerge(UP<Hy3Node> child, CollapsePolicy policy = CollapsePolicy::EmptySplits);
+	void insertAndMerge(std::unique_ptr<Hy3Node> child, CollapsePolicy policy = CollapsePolicy::EmptySplits);
 
 	void wrap(Hy3GroupLayout, GroupEphemeralityOption, bool change = true);
 
 protected:
-	Hy3Node() = default;
+	explicit Hy3Node(Hy3NodeType type): node_type(type), id(nextId()) {}
+
+private:
+	static uint64_t nextId();
+
+	// shared with the Hy3NodeRefs to this node, allocated by the first ref()
+	std::shared_ptr<Hy3Node* const> ref_anchor;
 };
 
+// A leaf of the tree. Implemented by the plugin for hyprland layout targets, and by
+// the tools for fake targets.
 struct Hy3TargetNode : Hy3Node {
-	WP<Layout::ITarget> target;
+	// geometry last pushed to the target, see Hy3Node::recalcSizePosRecursive
+	struct {
+		bool valid = false;
+		bool hidden = false;
+		Hy3Box logical;
+		Hy3Box visual;
+	} committed;
+
+	// false once the underlying target is gone
+	virtual bool alive() = 0;
+	virtual std::string title() = 0;
+	virtual bool urgent() = 0;
+	// Move the target, skipping any animation if `warp` is set.
+	virtual void applyGeometry(const Hy3Box& logical, const Hy3Box& visual, bool hidden, bool warp) = 0;
+	// Finish any running move animation of the target.
+	virtual void warpGeometry() = 0;
+	// shown by Hy3Node::debugNode
+	virtual std::string describe() = 0;
+
+protected:
+	Hy3TargetNode(): Hy3Node(Hy3NodeType::Target) {}
 };
 
 struct Hy3GroupNode : Hy3Node {
 	Hy3GroupLayout layout = Hy3GroupLayout::SplitH;
 	Hy3GroupLayout previous_nontab_layout = Hy3GroupLayout::SplitH;
-	std::list<UP<Hy3Node>> children;
+	Hy3NodeList children;
 	bool group_focused = true;
 	Hy3Node* focused_child = nullptr; // non-owning observer, always valid while parent group lives
 	ExpandFocusType expand_focused = ExpandFocusType::NotExpanded;
 	Ephemeral ephemeral = Ephemeral::Off;
 	bool locked = false;
 	bool containment = false;
-	Hy3TabGroupWrapper tab_bar;
+	// incremented when anything shown by the tab bars of this group or its ancestors
+	// changes, other than titles and urgency which are pushed to single entries.
+	uint64_t version = 0;
+	// only set on root nodes
+	Hy3TreeHost* tree_host = nullptr;
+
+	// Cached subtree aggregates. A valid group always has valid child groups, so
+	// invalidation can stop at the first group that is already invalid.
+	struct {
+		bool valid = false;
+		bool urgent = false;
+		size_t window_count = 0;
+		std::string title;
+	} aggregates;
 
-	Hy3GroupNode(Hy3GroupLayout layout);
+	explicit Hy3GroupNode(Hy3GroupLayout layout);
 	~Hy3GroupNode() override = default;
 
+	static std::unique_ptr<Hy3Node> create(Hy3NodePool& pool, Hy3GroupLayout layout);
+
 	bool isSplit() const { return layout == Hy3GroupLayout::SplitH || layout == Hy3GroupLayout::SplitV; }
 	bool isTab() const { return layout == Hy3GroupLayout::Tabbed; }
 
@@ -149,19 +369,22 @@ struct Hy3GroupNode : Hy3Node {
 	void collapseExpansions();
 	void setLayout(Hy3GroupLayout layout);
 	void setEphemeral(GroupEphemeralityOption ephemeral);
+	void updateAggregates();
 
-	auto findChild(Hy3Node& child) -> std::list<UP<Hy3Node>>::iterator;
-	void insertChild(std::list<UP<Hy3Node>>::iterator pos, UP<Hy3Node> child);
-	void insertChild(UP<Hy3Node> child);
-	UP<Hy3Node> extractChildRaw(std::list<UP<Hy3Node>>::iterator it);
-	UP<Hy3Node> extractChildRaw(Hy3Node& child);
-	UP<Hy3Node> replaceChild(std::list<UP<Hy3Node>>::iterator it, UP<Hy3Node> replacement);
-	UP<Hy3Node> extractChild(Hy3Node& child);
+	auto findChild(Hy3Node& child) -> Hy3NodeList::iterator;
+	void insertChild(Hy3NodeList::iterator pos, std::unique_ptr<Hy3Node> child);
+	void insertChild(std::unique_ptr<Hy3Node> child);
+	std::unique_ptr<Hy3Node> extractChildRaw(Hy3NodeList::iterator it);
+	std::unique_ptr<Hy3Node> extractChildRaw(Hy3Node& child);
+	std::unique_ptr<Hy3Node> replaceChild(Hy3NodeList::iterator it, std::unique_ptr<Hy3Node> replacement);
+	std::unique_ptr<Hy3Node> extractChild(Hy3Node& child);
+	// move the child at `it` in front of `pos`, with the same semantics as std::list::splice
+	void moveChild(Hy3NodeList::iterator it, Hy3NodeList::iterator pos);
 
-	friend struct Hy3Node;
+private:
+	void reindexChildren(size_t from);
 };
 
-struct Hy3RootNode : Hy3GroupNode {
-	Hy3Layout* algo = nullptr;
-	Hy3RootNode(Hy3Layout* layout);
-};
+Hy3Node* getOuterChild(Hy3GroupNode& group, ShiftDirection direction);
+Axis getAxis(Hy3GroupLayout layout);
+Axis getAxis(ShiftDirection direction);
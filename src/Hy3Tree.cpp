@@ -0,0 +1,534 @@
+#include "Hy3Tree.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+#include "log.hpp"
+#include "perf.hpp"
+
+bool shiftIsForward(ShiftDirection direction) {
+	return direction == ShiftDirection::Right || direction == ShiftDirection::Down;
+}
+
+bool shiftIsVertical(ShiftDirection direction) {
+	return direction == ShiftDirection::Up || direction == ShiftDirection::Down;
+}
+
+bool shiftMatchesLayout(Hy3GroupLayout layout, ShiftDirection direction) {
+	if (layout == Hy3GroupLayout::Root) return false;
+	return (layout == Hy3GroupLayout::SplitV && shiftIsVertical(direction))
+	    || (layout != Hy3GroupLayout::SplitV && !shiftIsVertical(direction));
+}
+
+ShiftDirection reverse(ShiftDirection direction) {
+	switch (direction) {
+	case ShiftDirection::Left: return ShiftDirection::Right;
+	case ShiftDirection::Right: return ShiftDirection::Left;
+	case ShiftDirection::Up: return ShiftDirection::Down;
+	case ShiftDirection::Down: return ShiftDirection::Up;
+	default: return direction;
+	}
+}
+
+Hy3InsertPlan planInsert(
+    Hy3GroupNode& root,
+    Hy3Node* at_point,
+    std::optional<Hy3Point> focal_point,
+    const Hy3AutotileParams& autotile
+) {
+	Hy3InsertPlan plan;
+
+	if (root.children.empty()) return plan;
+	auto* rootNode = root.children.front().get();
+
+	Hy3Node* opening_after = at_point;
+	if (!opening_after) opening_after = &rootNode->getFocusedNode();
+	opening_after = &opening_after->getPlacementActor();
+
+	// opening_after->parent cannot be nullptr
+	if (opening_after == rootNode) {
+		plan.wrap = opening_after;
+		plan.wrap_layout = Hy3GroupLayout::SplitH;
+		plan.wrap_ephemeral = GroupEphemeralityOption::Standard;
+	} else {
+		auto* opening_into = opening_after->parent;
+		auto& target_group = opening_into->as_group();
+		if (autotile.enable && target_group.children.size() > 1 && target_group.isSplit()) {
+			auto is_horizontal = target_group.layout == Hy3GroupLayout::SplitH;
+			auto trigger = is_horizontal ? autotile.trigger_width : autotile.trigger_height;
+			auto target_size = is_horizontal ? opening_into->visualBox.w : opening_into->visualBox.h;
+			auto size_after_addition = target_size / (target_group.children.size() + 1);
+
+			if (trigger >= 0 && (trigger == 0 || size_after_addition < trigger)) {
+				plan.wrap = opening_after;
+				plan.wrap_layout = is_horizontal ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
+				plan.wrap_ephemeral =
+				    autotile.ephemeral ? GroupEphemeralityOption::Ephemeral : GroupEphemeralityOption::Standard;
+			}
+		}
+
+		plan.opening_into = opening_into;
+	}
+
+	// For mouse drops, determine if we should insert before or after the target node
+	if (focal_point) {
+		auto layout = plan.wrap ? plan.wrap_layout : plan.opening_into->as_group().layout;
+		bool insert_before = false;
+
+		if (layout == Hy3GroupLayout::SplitH) {
+			insert_before = focal_point->x < opening_after->visualBox.x + opening_after->visualBox.w * 0.5;
+		} else if (layout == Hy3GroupLayout::SplitV) {
+			insert_before = focal_point->y < opening_after->visualBox.y + opening_after->visualBox.h * 0.5;
+		}
+
+		if (insert_before) {
+			// a wrapping group only contains opening_after
+			if (plan.wrap) {
+				opening_after = nullptr;
+			} else {
+				auto& parentGroup = plan.opening_into->as_group();
+				auto iter = parentGroup.findChild(*opening_after);
+				if (iter != parentGroup.children.begin()) {
+					opening_after = std::prev(iter)->get();
+				} else {
+					opening_after = nullptr;
+				}
+			}
+		}
+	}
+
+	plan.opening_after = opening_after;
+	return plan;
+}
+
+Hy3Node* insertPlanned(
+    Hy3GroupNode& root,
+    std::unique_ptr<Hy3Node> node_up,
+    const Hy3InsertPlan& plan,
+    Hy3GroupLayout first_layout
+) {
+	auto* opening_into = plan.opening_into;
+	auto* opening_after = plan.opening_after;
+
+	node_up->size_ratio = 1.0;
+
+	if (plan.wrap != nullptr) {
+		plan.wrap->wrap(plan.wrap_layout, plan.wrap_ephemeral);
+		opening_into = plan.wrap->parent;
+	} else if (opening_into == nullptr) {
+		if (root.tree_host == nullptr) {
+			hy3_log(ERR, "insertPlanned called on root {:x} without a host", (uintptr_t) &root);
+			return nullptr;
+		}
+
+		auto rootGroup = root.tree_host->createGroup(first_layout);
+		opening_into = rootGroup.get();
+		root.insertChild(std::move(rootGroup));
+	}
+
+	if (opening_into->is_target()) {
+		hy3_log(ERR, "opening_into node ({:x}) was not a group node", (uintptr_t) opening_into);
+		errorNotif();
+		return nullptr;
+	}
+
+	auto* node = node_up.get();
+
+	{
+		auto& group = opening_into->as_group();
+		if (opening_after == nullptr) {
+			group.insertChild(group.children.begin(), std::move(node_up));
+		} else {
+			auto iter = group.findChild(*opening_after);
+			group.insertChild(std::next(iter), std::move(node_up));
+		}
+	}
+
+	hy3_log(
+	    LOG,
+	    "tiled node {:x} inserted {} node {:x} in node {:x}",
+	    (uintptr_t) node,
+	    opening_after ? "after" : "at beginning of",
+	    (uintptr_t) opening_after,
+	    (uintptr_t) opening_into
+	);
+
+	node->markFocused();
+	if (root.tree_host) root.tree_host->recalcGeometry();
+	return node;
+}
+
+std::optional<Hy3Size> predictInsertSize(
+    const Hy3InsertPlan& plan,
+    const Hy3Box& area,
+    Hy3GroupLayout first_layout,
+    const Hy3GeometryParams& params
+) {
+	// Find the group the new node will be inserted into and how many children it will have.
+	// Groups created by the insertion (the first root group, or a wrapping group) take the
+	// box of the node they replace.
+	Hy3GroupLayout layout;
+	Hy3Box box;
+	size_t child_count;
+
+	if (plan.wrap != nullptr) {
+		layout = plan.wrap_layout;
+		box = plan.wrap->visualBox;
+		child_count = 2;
+	} else if (plan.opening_into != nullptr) {
+		auto& group = plan.opening_into->as_group();
+		// the expanded child keeps covering the group, and the rest is hidden
+		if (group.expand_focused != ExpandFocusType::NotExpanded) return std::nullopt;
+
+		layout = group.layout;
+		box = plan.opening_into->visualBox;
+		child_count = group.children.size() + 1;
+	} else {
+		box = area;
+		layout = first_layout;
+		child_count = 1;
+	}
+
+	// Keep in sync with recalcSizePosRecursive. The new node has a size ratio of 1. The group
+	// inset never applies as the only single child group here is the root group.
+	auto& gaps_in = params.gaps_in;
+	Hy3Size size;
+
+	switch (layout) {
+	case Hy3GroupLayout::SplitH:
+		size = {splitRatioUnit(box.w, child_count, gaps_in.left + gaps_in.right), box.h};
+		break;
+	case Hy3GroupLayout::SplitV:
+		size = {box.w, splitRatioUnit(box.h, child_count, gaps_in.top + gaps_in.bottom)};
+		break;
+	case Hy3GroupLayout::Tabbed: size = {box.w, box.h - params.tab_offset}; break;
+	case Hy3GroupLayout::Root: return std::nullopt;
+	}
+
+	if (size.w <= 0 || size.h <= 0) return std::nullopt;
+	return size;
+}
+
+void makeGroupOn(Hy3Node& node, Hy3GroupLayout layout, GroupEphemeralityOption ephemeral) {
+	node.wrap(layout, ephemeral);
+	node.parent->collapseParents(CollapsePolicy::InvalidOnly);
+	if (auto* host = node.host()) host->recalcGeometry();
+}
+
+void makeOppositeGroupOn(Hy3Node& node, GroupEphemeralityOption ephemeral) {
+	auto& group = node.parent->as_group();
+	auto layout =
+	    group.layout == Hy3GroupLayout::SplitH ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
+
+	if (group.children.size() == 1) {
+		group.setLayout(layout);
+		group.setEphemeral(ephemeral);
+		if (auto* host = node.host()) host->recalcGeometry();
+		return;
+	}
+
+	node.wrap(layout, ephemeral);
+}
+
+void expandNode(Hy3Node& node, ExpandOption option) {
+	auto* host = node.host();
+
+	switch (option) {
+	case ExpandOption::Expand: {
+		node.assertNotRoot();
+
+		if (node.is_group() && !node.as_group().group_focused)
+			node.as_group().expand_focused = ExpandFocusType::Stack;
+
+		auto& group = node.parent->as_group();
+		group.focused_child = &node;
+		group.expand_focused = ExpandFocusType::Latch;
+		group.invalidateAggregates();
+		group.bumpVersion();
+		group.markDirty();
+		node.markDirty();
+
+		if (host != nullptr) host->recalcGeometry();
+	} break;
+	case ExpandOption::Shrink:
+		if (node.is_group() && node.as_group().focused_child != nullptr) {
+			auto& group = node.as_group();
+
+			group.expand_focused = ExpandFocusType::NotExpanded;
+			if (group.focused_child->is_group())
+				group.focused_child->as_group().expand_focused = ExpandFocusType::Latch;
+			group.markDirty();
+			group.focused_child->markDirty();
+
+			if (host != nullptr) host->recalcGeometry();
+		}
+		break;
+	case ExpandOption::Base:
+		if (node.is_group()) {
+			node.as_group().collapseExpansions();
+			if (host != nullptr) host->recalcGeometry();
+		}
+		break;
+	case ExpandOption::Maximize: break;
+	case ExpandOption::Fullscreen: break;
+	}
+}
+
+static void equalizeRecursive(Hy3Node& node, bool recursive) {
+	if (!node.is_group()) return;
+	node.markDirty();
+
+	for (auto& child: node.as_group().children) {
+		child->size_ratio = 1.0f;
+		if (recursive) equalizeRecursive(*child, true);
+	}
+}
+
+void equalizeNode(Hy3Node& node, bool recursive) {
+	equalizeRecursive(node, recursive);
+	if (auto* host = node.host()) host->recalcGeometry();
+}
+
+void resizeNode(
+    Hy3Node& node,
+    Hy3Point delta,
+    const Hy3Box& area,
+    Hy3ResizeCorner corner,
+    bool no_animation
+) {
+	auto* actor = &node.getExpandActor();
+	auto& box = actor->visualBox;
+
+	// compared against the work area, as visualBox is the visible area
+	auto sticks = [](double a, double b) { return std::abs(a - b) < 2; };
+	auto display_left = sticks(box.x, area.x);
+	auto display_right = sticks(box.x + box.w, area.x + area.w);
+	auto display_top = sticks(box.y, area.y);
+	auto display_bottom = sticks(box.y + box.h, area.y + area.h);
+
+	if (actor->is_root() || (actor->is_target() && actor->parent->is_root())) {
+		if (display_left && display_right) delta.x = 0;
+		if (display_top && display_bottom) delta.y = 0;
+	}
+
+	if (delta.x == 0 && delta.y == 0) return;
+
+	auto corner_bits = static_cast<uint8_t>(corner);
+	auto has_corner = [&](Hy3ResizeCorner c) { return (corner_bits & static_cast<uint8_t>(c)) != 0; };
+
+	ShiftDirection edge_x;
+	ShiftDirection edge_y;
+
+	if (corner == Hy3ResizeCorner::None) {
+		edge_x = display_right ? ShiftDirection::Left : ShiftDirection::Right;
+		edge_y = display_bottom ? ShiftDirection::Up : ShiftDirection::Down;
+
+		if (edge_x == ShiftDirection::Left) delta.x = -delta.x;
+		if (edge_y == ShiftDirection::Up) delta.y = -delta.y;
+	} else {
+		edge_x = has_corner(Hy3ResizeCorner::TopLeft) || has_corner(Hy3ResizeCorner::BottomLeft)
+		           ? ShiftDirection::Left
+		           : ShiftDirection::Right;
+		edge_y = has_corner(Hy3ResizeCorner::TopLeft) || has_corner(Hy3ResizeCorner::TopRight)
+		           ? ShiftDirection::Up
+		           : ShiftDirection::Down;
+	}
+
+	if (auto* neighbor = actor->findNeighbor(edge_x)) neighbor->resize(reverse(edge_x), delta.x, no_animation);
+	if (auto* neighbor = actor->findNeighbor(edge_y)) neighbor->resize(reverse(edge_y), delta.y, no_animation);
+}
+
+Hy3ShiftResult shiftOrGetFocus(
+    Hy3Node& node,
+    ShiftDirection direction,
+    bool shift,
+    bool once,
+    bool visible,
+    CollapsePolicy policy
+) {
+	Hy3PerfScope perf(Hy3PerfOp::ShiftOrGetFocus);
+	auto* host = node.host();
+	auto* expand_actor = &node.getExpandActor();
+	auto* break_origin = &expand_actor->getPlacementActor();
+	auto* shift_actor = break_origin;
+	auto* break_parent = break_origin->parent;
+
+	auto has_broken_once = false;
+
+	// break parents until we hit a container oriented the same way as the shift
+	// direction
+	while (true) {
+		if (break_parent == nullptr) return {};
+
+		auto& group = break_parent->as_group(); // must be a group in order to be a parent
+
+		if (shiftMatchesLayout(group.layout, direction)
+		    && (!visible || !group.isTab()))
+		{
+			// group has the correct orientation
+
+			if (once && shift && has_broken_once) break;
+			if (break_origin != shift_actor) has_broken_once = true;
+
+			// if this movement would break out of the group, continue the break loop
+			// (do not enter this if) otherwise break.
+			if ((has_broken_once && once && shift)
+			    || !(
+			        (!shiftIsForward(direction) && group.children.front().get() == break_origin)
+			        || (shiftIsForward(direction) && group.children.back().get() == break_origin)
+			    ))
+				break;
+		}
+
+		if (break_parent->is_root()) {
+			if (!shift) return {.out_of_tree = true};
+
+			auto new_layout =
+			    shiftIsVertical(direction) ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
+			break_origin->wrap(new_layout, GroupEphemeralityOption::Standard);
+			break_parent = break_origin->parent;
+			break;
+		}
+
+		// special case 1-child nodes so once will only break the group
+		if (once && shift && break_origin->is_group() && break_origin->as_group().children.size() == 1) {
+			break;
+		}
+
+		break_origin = break_parent;
+		break_parent = break_origin->parent;
+	}
+
+	auto& parent_group = break_parent->as_group();
+	Hy3Node* target_group = break_parent;
+	Hy3NodeList::iterator insert;
+
+	if (break_origin == parent_group.children.front().get() && !shiftIsForward(direction)) {
+		if (!shift) return {};
+		insert = parent_group.children.begin();
+	} else if (break_origin == parent_group.children.back().get() && shiftIsForward(direction)) {
+		if (!shift) return {};
+		insert = parent_group.children.end();
+	} else {
+		auto& group_data = target_group->as_group();
+
+		auto iter = group_data.findChild(*break_origin);
+		if (shiftIsForward(direction)) iter = std::next(iter);
+		else iter = std::prev(iter);
+
+		auto& node = **iter;
+		if (node.is_target()
+				|| (node.is_group()
+						&& (node.as_group().expand_focused != ExpandFocusType::NotExpanded
+								|| node.as_group().locked))
+				|| (shift && once && has_broken_once))
+		{
+			if (shift) {
+				if (target_group == shift_actor->parent) {
+					if (shiftIsForward(direction)) insert = std::next(iter);
+					else insert = iter;
+				} else {
+					if (shiftIsForward(direction)) insert = iter;
+					else insert = std::next(iter);
+				}
+			} else return {.focus = &(*iter)->getFocusedNode()};
+		} else {
+			// break into neighboring groups until we hit a window
+			while (true) {
+				target_group = iter->get();
+				auto& group_data = target_group->as_group();
+
+				if (group_data.children.empty()) return {}; // in theory this would never happen
+
+				bool shift_after = false;
+
+				if (!shift && group_data.isTab()
+				    && group_data.focused_child != nullptr)
+				{
+					iter = group_data.findChild(*group_data.focused_child);
+				} else if (visible && group_data.isTab()
+				           && group_data.focused_child != nullptr)
+				{
+					// if the group is tabbed and we're going by visible nodes, jump to the current entry
+					iter = group_data.findChild(*group_data.focused_child);
+					shift_after = true;
+				} else if (shiftMatchesLayout(group_data.layout, direction)
+				           || (visible && group_data.isTab()))
+				{
+					// if the group has the same orientation as movement pick the
+					// last/first child based on movement direction
+					if (shiftIsForward(direction)) iter = group_data.children.begin();
+					else {
+						iter = std::prev(group_data.children.end());
+						shift_after = true;
+					}
+				} else {
+					if (group_data.focused_child != nullptr) {
+						iter = group_data.findChild(*group_data.focused_child);
+						shift_after = true;
+					} else {
+						iter = group_data.children.begin();
+					}
+				}
+
+				if (shift && once) {
+					if (shift_after) insert = std::next(iter);
+					else insert = iter;
+					break;
+				}
+
+				if ((*iter)->is_target()
+				    || ((*iter)->is_group()
+				        && (*iter)->as_group().expand_focused != ExpandFocusType::NotExpanded))
+				{
+					if (shift) {
+						if (shift_after) insert = std::next(iter);
+						else insert = iter;
+						break;
+					} else {
+						return {.focus = &(*iter)->getFocusedNode()};
+					}
+				}
+			}
+		}
+	}
+
+	auto& group_data = target_group->as_group();
+
+	if (target_group == shift_actor->parent) {
+		// Reorder within the same group (handles boundary no-ops naturally)
+		auto shift_it = group_data.findChild(*shift_actor);
+		group_data.moveChild(shift_it, insert);
+		shift_actor->parent->collapseParents(policy);
+	} else if (!shift_actor->parent->is_root() && shift_actor->parent->as_group().children.size() == 1 && target_group == shift_actor->parent->parent) {
+		// special cased to prevent size being reset to 1 on group break
+		auto* shift_parent = shift_actor->parent;
+		auto shift_actor_u = shift_parent->as_group().extractChildRaw(*shift_actor);
+		auto iter = group_data.findChild(*shift_parent);
+		group_data.replaceChild(iter, std::move(shift_actor_u));
+	} else {
+		auto target_group_ref = target_group->ref();
+		auto* shift_parent = shift_actor->parent;
+		auto shift_actor_u = shift_parent->as_group().extractChild(*shift_actor);
+
+		group_data.insertChild(insert, std::move(shift_actor_u));
+
+		shift_parent = shift_parent->collapseParents(CollapsePolicy::InvalidOnly);
+
+		if (shift_parent != nullptr && host) {
+			host->refreshTabBars(*shift_parent);
+		}
+
+		// Collapse any single-child groups left over from wrapping/extraction
+		if (auto* group = target_group_ref.get()) {
+			group->collapseParents(policy);
+		}
+	}
+
+	if (host) {
+		host->refreshTabBars(node);
+		host->recalcGeometry();
+	}
+
+	return {.shifted = true};
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "Hy3Node.hpp"
+#include "geometry.hpp"
+
+// Operations on a whole node tree, used by Hy3Layout and by the tools built on hy3core.
+
+bool shiftIsForward(ShiftDirection direction);
+bool shiftIsVertical(ShiftDirection direction);
+bool shiftMatchesLayout(Hy3GroupLayout layout, ShiftDirection direction);
+ShiftDirection reverse(ShiftDirection direction);
+
+// Where insertPlanned places a new node. Computed without modifying the tree so the
+// size of a new target can be predicted with the same placement and autotile logic.
+struct Hy3InsertPlan {
+	// null if the tree has no nodes yet and a root group will be created
+	Hy3Node* opening_into = nullptr;
+	// the new node goes after this node, or first in its group if null
+	Hy3Node* opening_after = nullptr;
+	// if set, wrapped in a new group which the node is inserted into instead
+	Hy3Node* wrap = nullptr;
+	Hy3GroupLayout wrap_layout = Hy3GroupLayout::SplitH;
+	GroupEphemeralityOption wrap_ephemeral = GroupEphemeralityOption::Standard;
+};
+
+// plugin:hy3:autotile settings for the tree a node is inserted into
+struct Hy3AutotileParams {
+	// autotile:enable, and the workspace is matched by autotile:workspaces
+	bool enable = false;
+	bool ephemeral = false;
+	int trigger_width = 0;
+	int trigger_height = 0;
+};
+
+// Plan inserting a node into the tree under `root`, next to `at_point` (the node under
+// `focal_point`) if set, otherwise next to the focused node.
+Hy3InsertPlan planInsert(
+    Hy3GroupNode& root,
+    Hy3Node* at_point,
+    std::optional<Hy3Point> focal_point,
+    const Hy3AutotileParams& autotile
+);
+
+// Insert `node` as planned and focus it. `first_layout` is the layout of the root group
+// created when the tree is empty. Returns the inserted node, or null on failure.
+Hy3Node* insertPlanned(
+    Hy3GroupNode& root,
+    std::unique_ptr<Hy3Node> node,
+    const Hy3InsertPlan& plan,
+    Hy3GroupLayout first_layout
+);
+
+// Size the geometry pass will give a target inserted as planned, read from the boxes of
+// the last pass. Pending geometry passes have to run first. `area` is the box of the root
+// group created when the tree is empty. Returns nullopt if the size depends on more than
+// the plan, such as in expanded groups.
+std::optional<Hy3Size> predictInsertSize(
+    const Hy3InsertPlan& plan,
+    const Hy3Box& area,
+    Hy3GroupLayout first_layout,
+    const Hy3GeometryParams& params
+);
+
+// Wrap `node` in a new group, then collapse the groups the wrap made redundant. See
+// hy3:makegroup.
+void makeGroupOn(Hy3Node& node, Hy3GroupLayout layout, GroupEphemeralityOption ephemeral);
+// Wrap `node` in a split opposite to its parent's, or turn the parent if `node` is its
+// only child. See hy3:makegroup opposite.
+void makeOppositeGroupOn(Hy3Node& node, GroupEphemeralityOption ephemeral);
+
+enum class ExpandOption {
+	Expand,
+	Shrink,
+	Base,
+	Maximize,
+	Fullscreen,
+};
+
+// Apply hy3:expand `option` to `node`, the focused node of its tree. Maximize and
+// Fullscreen are left to the host.
+void expandNode(Hy3Node& node, ExpandOption option);
+// Reset the size ratios of the children of `node`, and of all its descendants if
+// `recursive`.
+void equalizeNode(Hy3Node& node, bool recursive);
+
+// Corner of a target dragged by the mouse, with the bit values of hyprland's
+// Layout::eRectCorner.
+enum class Hy3ResizeCorner : uint8_t {
+	None = 0,
+	TopLeft = 1 << 0,
+	TopRight = 1 << 1,
+	BottomRight = 1 << 2,
+	BottomLeft = 1 << 3,
+};
+
+// Resize `node` by `delta` by moving the edges it shares with its neighbors. The edges
+// are those of `corner`, or without one the edges facing away from the sides of `area`
+// (the work area) the node touches. Targets filling the area are not resized.
+void resizeNode(
+    Hy3Node& node,
+    Hy3Point delta,
+    const Hy3Box& area,
+    Hy3ResizeCorner corner,
+    bool no_animation
+);
+
+struct Hy3ShiftResult {
+	// node to focus when not shifting
+	Hy3Node* focus = nullptr;
+	// the node was moved, its tab bars refreshed and a geometry pass scheduled
+	bool shifted = false;
+	// the direction leads out of the tree, to another monitor
+	bool out_of_tree = false;
+};
+
+// If shift is true, shift the node in the given direction, otherwise find the node to
+// focus in that direction. If once is true, only one group will be broken out of / into.
+Hy3ShiftResult shiftOrGetFocus(
+    Hy3Node& node,
+    ShiftDirection direction,
+    bool shift,
+    bool once,
+    bool visible,
+    CollapsePolicy policy
+);
@@ -0,0 +1,225 @@
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <hyprland/src/Compositor.hpp>
+#include <hyprland/src/desktop/state/FocusState.hpp>
+#include <hyprland/src/managers/input/InputManager.hpp>
+
+#include "Hy3Layout.hpp"
+#include "Hy3WindowNode.hpp"
+#include "globals.hpp"
+
+using Desktop::View::CWindow;
+
+std::unique_ptr<Hy3Node> Hy3WindowNode::create(Hy3NodePool& pool, SP<Layout::ITarget> target) {
+	auto* node = new (pool) Hy3WindowNode();
+	node->target = target;
+	node->target_key = target.get();
+	if (auto window = target->window()) node->window_key = window.get();
+	return std::unique_ptr<Hy3Node>(node);
+}
+
+bool Hy3WindowNode::alive() { return !this->target.expired(); }
+
+std::string Hy3WindowNode::title() { return windowOf(*this)->m_title; }
+
+bool Hy3WindowNode::urgent() { return windowOf(*this)->m_isUrgent; }
+
+// Keep in sync with WindowTarget::updatePos
+void Hy3WindowNode::applyGeometry(const Hy3Box& logical, const Hy3Box& visual, bool hidden, bool warp) {
+	auto target = targetOf(*this);
+	target->window()->setHidden(hidden);
+	target->setPositionGlobal({.logicalBox = toCBox(logical), .visualBox = toCBox(visual)});
+	if (warp) target->warpPositionSize();
+}
+
+void Hy3WindowNode::warpGeometry() { targetOf(*this)->warpPositionSize(); }
+
+std::string Hy3WindowNode::describe() {
+	std::stringstream buf;
+	buf << "hypr " << this->window_key;
+	return buf.str();
+}
+
+std::unique_ptr<Hy3Node> Hy3WindowGroup::create(Hy3NodePool& pool, Hy3GroupLayout layout) {
+	return std::unique_ptr<Hy3Node>(new (pool) Hy3WindowGroup(layout));
+}
+
+Hy3WindowNode& asWindowNode(Hy3Node& node) {
+	// every target in a Hy3Layout tree is a Hy3WindowNode
+	return static_cast<Hy3WindowNode&>(node.as_target_node());
+}
+
+SP<Layout::ITarget> targetOf(Hy3Node& node) {
+	auto& window_node = asWindowNode(node);
+	if (window_node.target.expired())
+		throw std::runtime_error("Attempted to upgrade an expired Hy3Node target");
+	return window_node.target.lock();
+}
+
+PHLWINDOW windowOf(Hy3Node& node) { return targetOf(node)->window(); }
+
+Hy3TabGroupWrapper& tabBarOf(Hy3GroupNode& group) {
+	// every group in a Hy3Layout tree is a Hy3WindowGroup
+	return static_cast<Hy3WindowGroup&>(group).tab_bar;
+}
+
+Hy3Layout* layoutOf(Hy3Node& node) { return static_cast<Hy3Layout*>(node.host()); }
+
+void focusNode(Hy3Node& node, bool warp, Desktop::eFocusReason reason) {
+	node.markFocused();
+
+	g_pInputManager->unconstrainMouse();
+
+	if (warp && Hy3Batch::active()) {
+		// warp once the batch has committed its geometry
+		g_batchWarp = node.ref();
+		warp = false;
+	} else if (auto* layout = layoutOf(node); warp && layout) {
+		// warping targets the node's current geometry
+		layout->flushGeometry();
+	}
+
+	switch (node.type()) {
+	case Hy3NodeType::Target: {
+		auto window = windowOf(node);
+		window->setHidden(false);
+		Desktop::focusState()->fullWindowFocus(window, reason);
+		break;
+	}
+	case Hy3NodeType::Group: {
+		Desktop::focusState()->resetWindowFocus();
+		for (auto& target: node.targets()) {
+			g_pCompositor->changeWindowZOrder(windowOf(target), true);
+		}
+		break;
+	}
+	}
+
+	if (warp) warpCursorToNode(node);
+}
+
+void warpCursorToNode(Hy3Node& node) {
+	switch (node.type()) {
+	case Hy3NodeType::Target: {
+		auto window = windowOf(node);
+		Hy3Layout::warpCursorToBox(window->m_position, window->m_size);
+		break;
+	}
+	case Hy3NodeType::Group: {
+		auto box = toCBox(node.visualBox);
+		Hy3Layout::warpCursorToBox(box.pos(), box.size());
+		break;
+	}
+	}
+}
+
+// Dirty tab groups are refreshed by the geometry pass, unless none is scheduled to run.
+static bool tabBarRefreshPending(Hy3GroupNode& group) {
+	if (!group.geometry_dirty) return false;
+
+	auto* layout = layoutOf(group);
+	return layout != nullptr && layout->geometryScheduled();
+}
+
+static void refreshFocusStateRecursive(Hy3Node& node) {
+	switch (node.type()) {
+	case Hy3NodeType::Target: windowOf(node)->updateDecorationValues(); break;
+	case Hy3NodeType::Group:
+		auto& group = node.as_group();
+
+		for (auto& child: group.children) {
+			refreshFocusStateRecursive(*child);
+		}
+
+		if (group.isTab() && !tabBarRefreshPending(group)) updateTabBar(group);
+		break;
+	}
+}
+
+void refreshFocusState(Hy3Node& node) {
+	refreshFocusStateRecursive(node);
+
+	for (auto& ancestor: node.ancestors()) {
+		auto& group = ancestor.parent->as_group();
+		if (group.isTab() && !tabBarRefreshPending(group)) updateTabBar(group);
+	}
+}
+
+// Cached position of each window in g_pCompositor->m_windows, which is kept in z-order.
+// Entries are checked against the window list on lookup, and the whole cache is rebuilt
+// when one turns out to be stale, so z-order changes never need to be tracked directly.
+static std::unordered_map<const CWindow*, size_t> z_order_ranks;
+
+static std::optional<size_t> getZOrderRank(const CWindow* window) {
+	auto& compositor_windows = g_pCompositor->m_windows;
+
+	auto lookup = [&]() -> std::optional<size_t> {
+		auto it = z_order_ranks.find(window);
+		if (it == z_order_ranks.end()) return std::nullopt;
+		if (it->second >= compositor_windows.size()) return std::nullopt;
+		if (compositor_windows[it->second].get() != window) return std::nullopt;
+		return it->second;
+	};
+
+	if (auto rank = lookup()) return rank;
+
+	z_order_ranks.clear();
+	for (size_t i = 0; i < compositor_windows.size(); i++) {
+		z_order_ranks[compositor_windows[i].get()] = i;
+	}
+
+	return lookup();
+}
+
+// Find the visible window with the highest z-order in this subtree.
+static PHLWINDOW findTopVisibleWindow(Hy3Node& node) {
+	PHLWINDOW result;
+	size_t result_rank = 0;
+
+	for (auto& target: node.targets(true)) {
+		auto window = windowOf(target);
+		auto rank = getZOrderRank(window.get());
+		if (!rank) continue;
+
+		if (result == nullptr || *rank > result_rank) {
+			result = window;
+			result_rank = *rank;
+		}
+	}
+
+	return result;
+}
+
+void updateTabBar(Hy3Node& node, bool no_animation) {
+	if (node.type() != Hy3NodeType::Group) return;
+
+	auto& group = node.as_group();
+	auto& tab_bar = tabBarOf(group);
+
+	if (group.isTab()) {
+		if (!tab_bar) tab_bar = Hy3TabGroup::create(node);
+		tab_bar->updateWithGroup(node, no_animation);
+
+		auto top_window = findTopVisibleWindow(node);
+		tab_bar->target_window = top_window;
+		if (top_window != nullptr) tab_bar->workspace = top_window->m_workspace;
+	} else if (tab_bar) {
+		tab_bar.release();
+	}
+}
+
+void updateTabEntries(Hy3Node& node) {
+	for (auto& ancestor: node.ancestors()) {
+		auto& tab_bar = tabBarOf(ancestor.parent->as_group());
+		if (tab_bar) tab_bar->updateEntry(ancestor);
+	}
+}
+
+void updateTabBarRecursive(Hy3Node& node) {
+	for (auto& ancestor: node.ancestors()) {
+		updateTabBar(ancestor);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <hyprland/src/defines.hpp>
+#include <hyprland/src/desktop/state/FocusState.hpp>
+#include <hyprland/src/desktop/view/Window.hpp>
+#include <hyprland/src/layout/target/Target.hpp>
+
+#include "Hy3Node.hpp"
+#include "TabGroup.hpp"
+
+class Hy3Layout;
+
+// Nodes of the trees owned by Hy3Layout, backed by hyprland layout targets.
+
+struct Hy3WindowNode : Hy3TargetNode {
+	WP<Layout::ITarget> target;
+
+	// keys this node is indexed under in Hy3Layout. stable for the target's lifetime,
+	// kept separately so the index can be cleaned up after the target expires.
+	const Layout::ITarget* target_key = nullptr;
+	const Desktop::View::CWindow* window_key = nullptr;
+
+	static std::unique_ptr<Hy3Node> create(Hy3NodePool& pool, SP<Layout::ITarget> target);
+
+	bool alive() override;
+	std::string title() override;
+	bool urgent() override;
+	void applyGeometry(const Hy3Box& logical, const Hy3Box& visual, bool hidden, bool warp) override;
+	void warpGeometry() override;
+	std::string describe() override;
+};
+
+// Every group of a Hy3Layout tree, including the root, is a Hy3WindowGroup.
+struct Hy3WindowGroup : Hy3GroupNode {
+	Hy3TabGroupWrapper tab_bar;
+
+	explicit Hy3WindowGroup(Hy3GroupLayout layout): Hy3GroupNode(layout) {}
+
+	static std::unique_ptr<Hy3Node> create(Hy3NodePool& pool, Hy3GroupLayout layout);
+};
+
+inline CBox toCBox(const Hy3Box& box) { return CBox(box.x, box.y, box.w, box.h); }
+inline Hy3Box toHy3Box(const CBox& box) { return Hy3Box {box.x, box.y, box.w, box.h}; }
+
+Hy3WindowNode& asWindowNode(Hy3Node& node);
+SP<Layout::ITarget> targetOf(Hy3Node& node);
+PHLWINDOW windowOf(Hy3Node& node);
+Hy3TabGroupWrapper& tabBarOf(Hy3GroupNode& group);
+Hy3Layout* layoutOf(Hy3Node& node);
+
+void focusNode(Hy3Node& node, bool warp, Desktop::eFocusReason reason);
+void warpCursorToNode(Hy3Node& node);
+// Refresh the decorations and tab bars whose focus state depends on whether this
+// node is focused: everything below it, and the tab bars above it.
+void refreshFocusState(Hy3Node& node);
+void updateTabBar(Hy3Node& node, bool no_animation = false);
+void updateTabBarRecursive(Hy3Node& node);
+// Update the title and urgency of the tab entries showing this node or its ancestors.
+void updateTabEntries(Hy3Node& node);
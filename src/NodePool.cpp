@@ -0,0 +1,104 @@
+#include "NodePool.hpp"
+
+#include <cstdint>
+#include <new>
+
+// number of node slots in each slab
+constexpr size_t SLAB_SLOTS = 32;
+
+struct alignas(std::max_align_t) Hy3NodePool::SlotHeader {
+	// nullptr for nodes allocated outside of a pool
+	Hy3NodePool* pool;
+	size_t size_class;
+};
+
+size_t Hy3NodePool::slotSize(size_t size) {
+	constexpr auto align = alignof(std::max_align_t);
+	return sizeof(Hy3NodePool::SlotHeader) + (size + align - 1) / align * align;
+}
+
+size_t Hy3NodePool::total_allocations = 0;
+
+Hy3NodePool* Hy3NodePool::create() { return new Hy3NodePool(); }
+
+void Hy3NodePool::release() {
+	this->released = true;
+	if (this->live == 0) delete this;
+}
+
+Hy3NodePool::SizeClass& Hy3NodePool::classFor(size_t size) {
+	for (auto& size_class: this->classes) {
+		if (size_class.size == size) return size_class;
+	}
+
+	return this->classes.emplace_back(SizeClass {.size = size});
+}
+
+void Hy3NodePool::grow(SizeClass& size_class) {
+	auto slot_size = slotSize(size_class.size);
+	auto& slab = size_class.slabs.emplace_back(new std::byte[slot_size * SLAB_SLOTS]);
+
+	// push in reverse so slots are handed out in address order
+	for (size_t i = SLAB_SLOTS; i > 0; i--) {
+		auto* slot = reinterpret_cast<FreeSlot*>(slab.get() + slot_size * (i - 1));
+		slot->next = size_class.free;
+		size_class.free = slot;
+	}
+}
+
+void* Hy3NodePool::allocate(size_t size) {
+	auto& size_class = this->classFor(size);
+	if (size_class.free == nullptr) this->grow(size_class);
+
+	auto* slot = size_class.free;
+	size_class.free = slot->next;
+
+	auto* header = new (slot) SlotHeader {
+	    .pool = this,
+	    .size_class = static_cast<size_t>(&size_class - this->classes.data()),
+	};
+
+	this->live++;
+	total_allocations++;
+	return header + 1;
+}
+
+void* Hy3NodePool::allocateUnpooled(size_t size) {
+	auto* header = new (::operator new(slotSize(size))) SlotHeader {.pool = nullptr, .size_class = 0};
+	total_allocations++;
+	return header + 1;
+}
+
+void Hy3NodePool::deallocate(void* ptr) {
+	if (ptr == nullptr) return;
+	auto* header = static_cast<SlotHeader*>(ptr) - 1;
+
+	if (header->pool == nullptr) {
+		::operator delete(header);
+	} else {
+		header->pool->free(header);
+	}
+}
+
+void Hy3NodePool::free(SlotHeader* header) {
+	auto& size_class = this->classes[header->size_class];
+	auto* slot = reinterpret_cast<FreeSlot*>(header);
+	slot->next = size_class.free;
+	size_class.free = slot;
+
+	this->live--;
+	if (this->released && this->live == 0) delete this;
+}
+
+size_t Hy3NodePool::totalAllocations() { return total_allocations; }
+
+Hy3NodePool::Stats Hy3NodePool::stats() const {
+	Stats stats {.live = this->live};
+
+	for (auto& size_class: this->classes) {
+		stats.slabs += size_class.slabs.size();
+		stats.capacity += size_class.slabs.size() * SLAB_SLOTS;
+	}
+
+	return stats;
+}
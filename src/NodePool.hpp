@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Slab allocator backing the nodes of a single Hy3Layout.
+//
+// Nodes are carved out of fixed size slabs with one free list per node size, so the
+// nodes of a workspace stay close together in memory and freed slots are reused by the
+// next node of the same type. Slabs are only returned to the system when the pool
+// itself is destroyed, which happens once the owning layout has released it and the
+// last node allocated from it (including nodes moved to other workspaces) is gone.
+class Hy3NodePool {
+public:
+	struct Stats {
+		size_t live = 0;
+		size_t capacity = 0;
+		size_t slabs = 0;
+	};
+
+	static Hy3NodePool* create();
+	// Drop the owning layout's reference to the pool.
+	void release();
+
+	void* allocate(size_t size);
+	// Allocate a node outside of any pool, using the same slot header as pooled nodes.
+	static void* allocateUnpooled(size_t size);
+	// Free memory returned by allocate or allocateUnpooled.
+	static void deallocate(void* ptr);
+
+	Stats stats() const;
+	// number of nodes allocated by any pool or unpooled since startup
+	static size_t totalAllocations();
+
+private:
+	struct FreeSlot {
+		FreeSlot* next;
+	};
+
+	struct SizeClass {
+		size_t size = 0;
+		FreeSlot* free = nullptr;
+		std::vector<std::unique_ptr<std::byte[]>> slabs;
+	};
+
+	struct SlotHeader;
+
+	std::vector<SizeClass> classes;
+	size_t live = 0;
+	bool released = false;
+
+	static size_t total_allocations;
+
+	Hy3NodePool() = default;
+	static size_t slotSize(size_t size);
+	SizeClass& classFor(size_t size);
+	void grow(SizeClass&);
+	void free(SlotHeader*);
+};
@@ -1,5 +1,7 @@
 #include "TabGroup.hpp"
+#include <array>
 #include <optional>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -23,34 +25,14 @@
 #include <pango/pangocairo.h>
 #include <pixman.h>
 
+#include "Hy3WindowNode.hpp"
 #include "log.hpp"
 #include "globals.hpp"
 #include "render.hpp"
 #include "render/Renderer.hpp"
 #include "render/pass/PassElement.hpp"
 
-using Hyprgraphics::CColor;
-
-// This is a workaround CHyprColor not having working arithmetic operator...
-template <typename... Args>
-CHyprColor merge_colors(Args... colors) {
-	auto merge_oklab = []<typename... Args2>(Args2... colors) {
-		return CColor::SOkLab {
-		    .l = ((colors.first * colors.second.l) + ...),
-		    .a = ((colors.first * colors.second.a) + ...),
-		    .b = ((colors.first * colors.second.b) + ...),
-		};
-	};
-
-	auto oklab = merge_oklab(std::make_pair(colors.first, colors.second.asOkLab())...);
-	auto alpha = ((colors.first * colors.second.a) + ...);
-
-	// the alpha is linear, otherwise use the fact that CColor can take an OkLab and do the correct
-	// conversion to an rgb
-	return CHyprColor(Hyprgraphics::CColor(oklab), alpha);
-}
-
-Hy3TabBarEntry::Hy3TabBarEntry(Hy3TabBar& tab_bar, Hy3Node& node): tab_bar(tab_bar), node(&node) {
+Hy3TabBarEntry::Hy3TabBarEntry(Hy3TabBar& tab_bar, Hy3Node& node): tab_bar(tab_bar), node_id(node.id) {
 	g_pAnimationManager->createAnimation(
 	    0.0F,
 	    this->active,
@@ -126,10 +108,10 @@ Hy3TabBarEntry::Hy3TabBarEntry(Hy3TabBar& tab_bar, Hy3Node& node): tab_bar(tab_b
 	*this->fade_opacity = 1.0;
 }
 
-bool Hy3TabBarEntry::operator==(const Hy3Node& node) const { return this->node == &node; }
+bool Hy3TabBarEntry::operator==(const Hy3Node& node) const { return this->node_id == node.id; }
 
 bool Hy3TabBarEntry::operator==(const Hy3TabBarEntry& entry) const {
-	return this->node == entry.node;
+	return this->node_id == entry.node_id;
 }
 
 void Hy3TabBarEntry::setActive(bool active) {
@@ -182,39 +164,12 @@ bool Hy3TabBarEntry::shouldRemove() {
 
 void Hy3TabBarEntry::render(float scale, CBox& box, float opacity_mul) {
 	auto opacity = opacity_mul * this->fade_opacity->value();
+	auto& tabs = g_config.tabs;
 
-	// clang-format off
-	static const auto s_radius = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:radius");
-	static const auto border_width = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:border_width");
-	static const auto s_opacity = CConfigValue<Config::FLOAT>("plugin:hy3:tabs:opacity");
-	static const auto blur = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:blur");
-	static const auto col_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active");
-	static const auto col_border_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_border");
-	static const auto col_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused");
-	static const auto col_border_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused_border");
-	static const auto col_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent");
-	static const auto col_border_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent_border");
-	static const auto col_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked");
-	static const auto col_border_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked_border");
-	static const auto col_active_alt_monitor = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_alt_monitor");
-	static const auto col_border_active_alt_monitor = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_alt_monitor_border");
-	static const auto col_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive");
-	static const auto col_border_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive_border");
-	// clang-format on
-
-	auto radius = std::min((double) *s_radius * scale, std::min(box.width * 0.5, box.height * 0.5));
-
-	auto color =
-	    this->mergeColors(*col_active, *col_focused, *col_urgent, *col_locked, *col_active_alt_monitor, *col_inactive);
-
-	auto border_color = this->mergeColors(
-	    *col_border_active,
-	    *col_border_focused,
-	    *col_border_urgent,
-	    *col_border_locked,
-	    *col_border_active_alt_monitor,
-	    *col_border_inactive
-	);
+	auto radius = std::min((double) tabs.radius * scale, std::min(box.width * 0.5, box.height * 0.5));
+
+	auto color = this->mergeColors(tabs.fill);
+	auto border_color = this->mergeColors(tabs.border);
 
 	box.round();
 
@@ -223,11 +178,11 @@ void Hy3TabBarEntry::render(float scale, CBox& box, float opacity_mul) {
 
 	Hy3Render::renderTab(
 	    box,
-	    opacity * *s_opacity,
-	    *blur,
+	    opacity * tabs.opacity,
+	    tabs.blur,
 	    color,
 	    border_color,
-	    *border_width,
+	    tabs.border_width,
 	    radius
 	);
 
@@ -235,33 +190,32 @@ void Hy3TabBarEntry::render(float scale, CBox& box, float opacity_mul) {
 }
 
 void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
-	// clang-format off
-	static const auto render_text = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:render_text");
-	static const auto text_center = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:text_center");
-	static const auto text_font = CConfigValue<Config::STRING>("plugin:hy3:tabs:text_font");
-	static const auto text_height = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:text_height");
-	static const auto text_padding = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:text_padding");
-	static const auto col_text_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_text");
-	static const auto col_text_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused_text");
-	static const auto col_text_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent_text");
-	static const auto col_text_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked_text");
-	static const auto col_text_active_alt_monitor = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_alt_monitor_text");
-	static const auto col_text_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive_text");
-	// clang-format on
-
-	if (!*render_text) {
+	auto& tabs = g_config.tabs;
+
+	if (!tabs.render_text) {
 		if (this->texture) this->texture.reset();
 		return;
 	}
 
-	auto padding = *text_padding * scale;
+	auto padding = tabs.text_padding * scale;
 	auto width = box.width - padding * 2;
 
+	// hold back title-only changes that come in faster than the configured interval
+	auto now = std::chrono::steady_clock::now();
+	auto title_changed = this->last_render.window_title != this->window_title;
+	if (title_changed && this->texture && tabs.text_min_rerender_interval > 0) {
+		auto rerender_at = this->last_render.time + std::chrono::milliseconds(tabs.text_min_rerender_interval);
+		this->title_rerender_pending = now < rerender_at;
+		this->title_rerender_at = rerender_at;
+	} else {
+		this->title_rerender_pending = false;
+	}
+
 	if (!this->texture
 	    // clang-format off
-	    || this->last_render.window_title != this->window_title
-			|| this->last_render.text_font != *text_font
-	    || this->last_render.font_height != *text_height
+	    || (title_changed && !this->title_rerender_pending)
+			|| this->last_render.text_font != tabs.text_font
+	    || this->last_render.font_height != tabs.text_height
 			|| this->last_render.scale != scale
 	    // clang-format on
 	    // If render width was smaller than full render width and size changed,
@@ -270,9 +224,11 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 	        && (width < this->last_render.full_logical_width
 	            || this->last_render.logical_width != this->last_render.full_logical_width)))
 	{
+		this->title_rerender_pending = false;
+		this->last_render.time = now;
 		this->last_render.window_title = this->window_title;
-		this->last_render.text_font = *text_font;
-		this->last_render.font_height = *text_height;
+		this->last_render.text_font = tabs.text_font;
+		this->last_render.font_height = tabs.text_height;
 		this->last_render.scale = scale;
 		this->last_render.render_width = width;
 
@@ -281,8 +237,8 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 		auto* layout = pango_layout_new(context);
 		pango_layout_set_text(layout, this->window_title.c_str(), -1);
 
-		auto* font_desc = pango_font_description_from_string((*text_font).c_str());
-		pango_font_description_set_size(font_desc, *text_height * scale * PANGO_SCALE);
+		auto* font_desc = pango_font_description_from_string(tabs.text_font.c_str());
+		pango_font_description_set_size(font_desc, tabs.text_height * scale * PANGO_SCALE);
 		pango_layout_set_font_description(layout, font_desc);
 		pango_font_description_free(font_desc);
 
@@ -336,7 +292,7 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 	}
 
 	auto x_offset =
-	    *text_center ? box.w * 0.5 - this->last_render.logical_width * 0.5 : *text_padding;
+	    tabs.text_center ? box.w * 0.5 - this->last_render.logical_width * 0.5 : tabs.text_padding;
 
 	auto y_offset = box.h * 0.5 - this->last_render.logical_height * 0.5;
 
@@ -349,14 +305,7 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 
 	texture_box.round();
 
-	auto c = mergeColors(
-	    *col_text_active,
-	    *col_text_focused,
-	    *col_text_urgent,
-	    *col_text_locked,
-	    *col_text_active_alt_monitor,
-	    *col_text_inactive
-	);
+	auto c = this->mergeColors(tabs.text);
 
 	glBlendFunc(GL_CONSTANT_COLOR, GL_ONE_MINUS_SRC_ALPHA);
 	glBlendColor(c.r, c.g, c.b, c.a);
@@ -367,14 +316,7 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-CHyprColor Hy3TabBarEntry::mergeColors(
-    const CHyprColor& active,
-    const CHyprColor& focused,
-    const CHyprColor& urgent,
-    const CHyprColor& locked,
-    const CHyprColor& active_alt_monitor,
-    const CHyprColor& inactive
-) {
+CHyprColor Hy3TabBarEntry::mergeColors(const Hy3TabColorSet& colors) {
 	auto active_v = this->active->value();
 	auto urgent_v = std::max(0.0f, this->urgent->value() - active_v);
 	auto focused_v = std::max(0.0f, this->focused->value() - active_v - urgent_v);
@@ -382,17 +324,18 @@ CHyprColor Hy3TabBarEntry::mergeColors(
 	auto inactive_v = 1.0f - (active_v + urgent_v + focused_v + locked_v);
 
 	auto active_monitor_v = this->active_monitor->value();
-	auto active_alt_monitor_v = active_v * (1.0 - active_monitor_v);
+	auto active_alt_monitor_v = active_v * (1.0f - active_monitor_v);
 	active_v *= active_monitor_v;
 
-	return merge_colors(
-	    std::make_pair(active_v, active),
-	    std::make_pair(urgent_v, urgent),
-	    std::make_pair(focused_v, focused),
-	    std::make_pair(locked_v, locked),
-	    std::make_pair(active_alt_monitor_v, active_alt_monitor),
-	    std::make_pair(inactive_v, inactive)
-	);
+	std::array<float, Hy3TabColorSet::Count> weights;
+	weights[Hy3TabColorSet::Active] = active_v;
+	weights[Hy3TabColorSet::Focused] = focused_v;
+	weights[Hy3TabColorSet::Urgent] = urgent_v;
+	weights[Hy3TabColorSet::Locked] = locked_v;
+	weights[Hy3TabColorSet::ActiveAltMonitor] = active_alt_monitor_v;
+	weights[Hy3TabColorSet::Inactive] = inactive_v;
+
+	return colors.merge(weights);
 }
 
 Hy3TabBar::Hy3TabBar() {
@@ -431,6 +374,12 @@ void Hy3TabBar::tick() {
 				this->dirty = true;
 			}
 
+			if (iter->title_rerender_pending
+			    && std::chrono::steady_clock::now() >= iter->title_rerender_at)
+			{
+				this->dirty = true;
+			}
+
 			iter = std::next(iter);
 		}
 	}
@@ -438,51 +387,60 @@ void Hy3TabBar::tick() {
 	if (this->entries.empty()) this->destroy = true;
 }
 
-void Hy3TabBar::updateNodeList(std::list<UP<Hy3Node>>& nodes) {
+void Hy3TabBar::updateNodeList(Hy3NodeList& nodes) {
 	std::list<Hy3TabBarEntry> pool;
 	pool.splice(pool.begin(), this->entries);
 
+	// Entries are looked up by node and by last index. emplace keeps the first entry in
+	// pool order for each key, matching what a linear search over the pool would find.
+	std::unordered_map<uint64_t, std::list<Hy3TabBarEntry>::iterator> by_node;
+	by_node.reserve(pool.size());
+	for (auto it = pool.begin(); it != pool.end(); ++it) {
+		by_node.emplace(it->node_id, it);
+	}
+
 	for (auto node = nodes.begin(); node != nodes.end(); ++node) {
-		auto match = std::find_if(pool.begin(), pool.end(), [&node](auto& entry) {
-			return **node == entry;
-		});
+		auto match = by_node.find((*node)->id);
 
-		if (match != pool.end()) {
-			match->node = node->get();
-			this->entries.splice(this->entries.end(), pool, match);
+		if (match != by_node.end()) {
+			this->entries.splice(this->entries.end(), pool, match->second);
 		}
 	}
 
+	std::unordered_map<int, std::list<Hy3TabBarEntry>::iterator> by_index;
+	by_index.reserve(pool.size());
+	for (auto it = pool.begin(); it != pool.end(); ++it) {
+		by_index.emplace(it->lastIndex, it);
+	}
+
 	// TODO: index match is wrong if a move results in the addition of a node and destruction of another in one op
 	auto entry = this->entries.begin();
 	int node_index = 0;
 	for (auto node = nodes.begin(); node != nodes.end(); ++node, ++node_index) {
-		if (entry != this->entries.end() && entry->node == node->get()) {
+		if (entry != this->entries.end() && entry->node_id == (*node)->id) {
 			++entry;
 			continue;
 		}
 
-		auto match = std::find_if(pool.begin(), pool.end(), [&node_index](auto& entry) {
-			return entry.lastIndex == node_index;
-		});
+		auto match = by_index.find(node_index);
 
-		if (match != pool.end()) {
-			match->node = node->get();
-			this->entries.splice(entry, pool, match);
+		if (match != by_index.end()) {
+			match->second->node_id = (*node)->id;
+			this->entries.splice(entry, pool, match->second);
 		}
 	}
 
 	entry = this->entries.begin();
 	node_index = 0;
 	for (auto node = nodes.begin(); node != nodes.end(); ++node, ++node_index) {
-		if (entry == this->entries.end() || entry->node != node->get()) {
+		if (entry == this->entries.end() || entry->node_id != (*node)->id) {
 			entry = this->entries.emplace(entry, *this, **node);
 		}
 
 		entry->unDestroy();
 		entry->lastIndex = node_index;
 
-		auto* parent = (*node)->parent.get();
+		auto* parent = (*node)->parent;
 		auto& parent_group = parent->as_group();
 		auto parent_focused = parent->isIndirectlyFocused();
 
@@ -494,7 +452,7 @@ void Hy3TabBar::updateNodeList(std::list<UP<Hy3Node>>& nodes) {
 		entry->setActive(active);
 
 		auto last_monitor = Desktop::focusState()->monitor();
-		entry->setMonitorActive(active && (!last_monitor || (*node)->layout()->monitor() == last_monitor));
+		entry->setMonitorActive(active && (!last_monitor || layoutOf(**node)->monitor() == last_monitor));
 
 		entry->setUrgent((*node)->isUrgent());
 		entry->setWindowTitle((*node)->getTitle());
@@ -602,26 +560,51 @@ Hy3TabGroup::Hy3TabGroup(Hy3Node& node) {
 	this->updateWithGroup(node, true);
 	this->pos->warp();
 	this->size->warp();
-	this->bar.monitor_id = node.layout()->workspace()->m_monitor->m_id;
+	this->bar.monitor_id = layoutOf(node)->workspace()->m_monitor->m_id;
 }
 
 void Hy3TabGroup::updateWithGroup(Hy3Node& node, bool warp) {
-	static const auto bar_height = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:height");
-
-	auto tpos = node.visualBox.pos();
-	auto tsize = Vector2D(node.visualBox.w, *bar_height);
+	auto tpos = toCBox(node.visualBox).pos();
+	auto tsize = Vector2D(node.visualBox.w, g_config.tabs.height);
 
 	this->hidden = node.hidden;
+	auto moved = false;
+
 	if (this->pos->goal() != tpos) {
 		*this->pos = tpos;
 		if (warp) this->pos->warp();
+		moved = true;
 	}
 
 	if (this->size->goal() != tsize) {
 		*this->size = tsize;
 		if (warp) this->size->warp();
+		moved = true;
+	}
+
+	auto& group = node.as_group();
+	auto indirectly_focused = node.isIndirectlyFocused();
+	auto last_monitor = Desktop::focusState()->monitor();
+	auto monitor_focused = !last_monitor || layoutOf(node)->monitor() == last_monitor;
+
+	// nothing shown by the entries changed since the last sync
+	if (!warp && !moved && this->synced.valid && this->synced.node_id == node.id
+	    && this->synced.version == group.version
+	    && this->synced.indirectly_focused == indirectly_focused
+	    && this->synced.monitor_focused == monitor_focused)
+	{
+		if (this->bar.dirty) this->tick();
+		return;
 	}
 
+	this->synced = {
+	    .valid = true,
+	    .node_id = node.id,
+	    .version = group.version,
+	    .indirectly_focused = indirectly_focused,
+	    .monitor_focused = monitor_focused,
+	};
+
 	this->bar.updateNodeList(node.as_group().children);
 	this->bar.updateAnimations(warp);
 
@@ -635,6 +618,16 @@ void Hy3TabGroup::updateWithGroup(Hy3Node& node, bool warp) {
 	if (this->bar.dirty) this->tick();
 }
 
+void Hy3TabGroup::updateEntry(Hy3Node& node) {
+	for (auto& entry: this->bar.entries) {
+		if (entry == node && !entry.destroying) {
+			entry.setUrgent(node.isUrgent());
+			entry.setWindowTitle(node.getTitle());
+			return;
+		}
+	}
+}
+
 void Hy3TabBar::damageBox(const Vector2D* position, const Vector2D* size) {
 	auto box = CBox {position->x, position->y, size->x, size->y};
 	// Either a rounding error or an issue below makes this necessary.
@@ -644,16 +637,12 @@ void Hy3TabBar::damageBox(const Vector2D* position, const Vector2D* size) {
 }
 
 void Hy3TabGroup::tick() {
-	static const auto enter_from_top = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:from_top");
-	static const auto padding = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:padding");
-	static const auto no_gaps_when_only = CConfigValue<Config::INTEGER>("plugin:hy3:no_gaps_when_only");
-
 	this->bar.tick();
 
 	if (valid(this->workspace) && this->workspace->m_monitor) {
 		auto has_fullscreen = this->workspace->m_hasFullscreenWindow;
 
-		if (!has_fullscreen && *no_gaps_when_only) {
+		if (!has_fullscreen && g_config.no_gaps_when_only) {
 			auto* hy3 = hy3InstanceForWorkspace(this->workspace);
 			auto root_node = hy3 ? hy3->getWorkspaceRootGroup(this->workspace.get()) : nullptr;
 			has_fullscreen = root_node != nullptr && root_node->as_group().children.size() == 1
@@ -706,9 +695,9 @@ void Hy3TabGroup::tick() {
 
 	if (this->bar.destroy || this->bar.dirty) {
 		// damage any area that could be covered by bar in/out animations
-		size.y = size.y * 2 + *padding;
-		if (*enter_from_top) {
-			pos.y -= *padding;
+		size.y = size.y * 2 + g_config.tabs.padding;
+		if (g_config.tabs.from_top) {
+			pos.y -= g_config.tabs.padding;
 		}
 
 		this->bar.damageBox(&pos, &size);
@@ -734,9 +723,8 @@ std::pair<CBox, CBox> Hy3TabGroup::getRenderBB() const {
 }
 
 void Hy3TabGroup::renderTabBar() {
-	static const auto window_rounding = CConfigValue<Config::INTEGER>("decoration:rounding");
-	static const auto enter_from_top = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:from_top");
-	static const auto padding = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:padding");
+	auto padding = g_config.tabs.padding;
+	auto enter_from_top = g_config.tabs.from_top;
 
 	auto [box, scaledBox] = this->getRenderBB();
 
@@ -799,7 +787,7 @@ void Hy3TabGroup::renderTabBar() {
 
 			CBox window_box = {wpos.x, wpos.y, wsize.x, wsize.y};
 			auto border = window->getRealBorderSize();
-			auto radius = *window_rounding + border;
+			auto radius = g_config.window_rounding + border;
 			window_box.expand(border);
 			// scaleBox(&window_box, scale);
 			window_box.scale(scale);
@@ -820,12 +808,12 @@ void Hy3TabGroup::renderTabBar() {
 
 	auto render_entry = [&](Hy3TabBarEntry& entry) {
 		Vector2D entry_pos = {
-		    (box.x + (entry.offset->value() * box.w) + (*padding * 0.5)) * scale,
+		    (box.x + (entry.offset->value() * box.w) + (padding * 0.5)) * scale,
 		    scaledBox.y
-		        + ((entry.vertical_pos->value() * (box.h + *padding) * scale)
-		           * (*enter_from_top ? -1 : 1)),
+		        + ((entry.vertical_pos->value() * (box.h + padding) * scale)
+		           * (enter_from_top ? -1 : 1)),
 		};
-		Vector2D entry_size = {((entry.width->value() * box.w) - *padding) * scale, scaledBox.h};
+		Vector2D entry_size = {((entry.width->value() * box.w) - padding) * scale, scaledBox.h};
 		if (entry_size.x < 0 || entry_size.y < 0 || fade_opacity == 0.0) return;
 
 		CBox box = {
@@ -863,37 +851,13 @@ std::vector<UP<IPassElement>> Hy3TabPassElement::draw() {
 	return {};
 }
 
-bool Hy3TabPassElement::needsPrecomputeBlur() {
-	// clang-format off
-	static const auto s_opacity = CConfigValue<Config::FLOAT>("plugin:hy3:tabs:opacity");
-	static const auto blur = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:blur");
-	static const auto col_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active");
-	static const auto col_border_active = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:active_border");
-	static const auto col_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused");
-	static const auto col_border_focused = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:focused_border");
-	static const auto col_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent");
-	static const auto col_border_urgent = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:urgent_border");
-	static const auto col_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked");
-	static const auto col_border_locked = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:locked_border");
-	static const auto col_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive");
-	static const auto col_border_inactive = CConfigValue<Config::INTEGER>("plugin:hy3:tabs:colors:inactive_border");
-	// clang-format on
-
-	if (!*blur) return false;
-	if (*s_opacity < 1.0) return false;
-
-	auto needsblur = [](const auto& col) { return CHyprColor(*col).a < 1.0; };
-	return needsblur(col_active) || needsblur(col_border_active) || needsblur(col_focused)
-	    || needsblur(col_border_focused) || needsblur(col_urgent) || needsblur(col_border_urgent)
-	    || needsblur(col_locked) || needsblur(col_border_locked) || needsblur(col_inactive)
-	    || needsblur(col_border_inactive);
-}
+bool Hy3TabPassElement::needsPrecomputeBlur() { return g_config.tabs.needs_blur; }
 
 std::optional<CBox> Hy3TabPassElement::boundingBox() { return this->group->getRenderBB().first; }
 
 void findOverlappingWindows(Hy3Node& node, float height, std::vector<PHLWINDOWREF>& windows) {
 	switch (node.type()) {
-	case Hy3NodeType::Target: windows.push_back(node.as_window()); break;
+	case Hy3NodeType::Target: windows.push_back(windowOf(node)); break;
 	case Hy3NodeType::Group:
 		auto& group = node.as_group();
 
@@ -6,6 +6,7 @@
 class Hy3TabGroup;
 class Hy3TabBar;
 
+#include <chrono>
 #include <list>
 #include <vector>
 
@@ -30,6 +31,7 @@ struct Hy3TabGroupWrapper {
 	operator bool() const { return inner.get() != nullptr; }
 };
 
+#include "Hy3Config.hpp"
 #include "Hy3Node.hpp"
 
 struct Hy3TabBarEntry {
@@ -45,9 +47,13 @@ struct Hy3TabBarEntry {
 	PHLANIMVAR<float> vertical_pos; // 0.0-1.0, user specified direction
 	PHLANIMVAR<float> fade_opacity; // 0.0-1.0
 	Hy3TabBar& tab_bar;
-	Hy3Node* node; // only used for comparison. do not deref.
+	uint64_t node_id; // Hy3Node::id of the node shown by this entry
 	int lastIndex = -1;
 
+	// set when a title change is held back by tabs:text_min_rerender_interval
+	bool title_rerender_pending = false;
+	std::chrono::steady_clock::time_point title_rerender_at;
+
 	struct {
 		float scale = 0.0;
 		std::string window_title;
@@ -64,6 +70,8 @@ struct Hy3TabBarEntry {
 
 		int logical_width = 0;
 		int logical_height = 0;
+
+		std::chrono::steady_clock::time_point time;
 	} last_render;
 
 	Hy3TabBarEntry(Hy3TabBar&, Hy3Node&);
@@ -82,14 +90,8 @@ struct Hy3TabBarEntry {
 
 private:
 	void renderText(float scale, CBox& box, float opacity);
-	CHyprColor mergeColors(
-	    const CHyprColor& active,
-	    const CHyprColor& focused,
-	    const CHyprColor& urgent,
-	    const CHyprColor& locked,
-	    const CHyprColor& inactiveMonitor,
-	    const CHyprColor& inactive
-	);
+	// blend a color set by this entry's animated state
+	CHyprColor mergeColors(const Hy3TabColorSet& colors);
 };
 
 class Hy3TabBar {
@@ -107,7 +109,7 @@ public:
 	void damageBox(const Vector2D* position, const Vector2D* size);
 
 	void tick();
-	void updateNodeList(std::list<UP<Hy3Node>>& nodes);
+	void updateNodeList(Hy3NodeList& nodes);
 	void updateAnimations(bool warp = false);
 	void setSize(Vector2D);
 
@@ -154,6 +156,8 @@ public:
 
 	// update tab bar with node position and data. UB if node is not a group.
 	void updateWithGroup(Hy3Node&, bool warp);
+	// update the title and urgency of the entry for the given child node.
+	void updateEntry(Hy3Node&);
 	void tick();
 	std::pair<CBox, CBox> getRenderBB() const;
 	// render the scaled tab bar on the current monitor.
@@ -165,6 +169,15 @@ private:
 	Vector2D last_pos;
 	Vector2D last_size;
 
+	// state of the group at the last full sync in updateWithGroup
+	struct {
+		bool valid = false;
+		uint64_t node_id = 0;
+		uint64_t version = 0;
+		bool indirectly_focused = false;
+		bool monitor_focused = false;
+	} synced;
+
 	Hy3TabGroup();
 
 	// moving a Hy3TabGroup will unregister any active animations
@@ -1,6 +1,10 @@
+#include <format>
+#include <functional>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/desktop/DesktopTypes.hpp>
@@ -12,6 +16,8 @@
 
 #include "dispatchers.hpp"
 #include "log.hpp"
+#include "perf.hpp"
+#include "record.hpp"
 #include "globals.hpp"
 #include "src/SharedDefs.hpp"
 
@@ -947,6 +953,269 @@ static SDispatchResult dispatch_debug(std::string arg) {
 	return debugNodes();
 }
 
+static SDispatchResult debugPerf(bool reset) {
+	if (!Hy3Perf::enabled) {
+		return { .success = false, .error = "plugin:hy3:debug:perf_stats is disabled" };
+	}
+
+	auto output = Hy3Perf::reportJson();
+	if (reset) Hy3Perf::reset();
+
+	hy3_log(LOG, "DEBUG PERF\n{}", output);
+	return { .success = false, .error = output };
+}
+
+static int luaDebugPerf(lua_State* L) {
+	static constexpr const char* FN = "hl.plugin.hy3.debug_perf";
+	luaCheckArgCount(L, FN, 0, 1);
+
+	bool reset = false;
+	if (luaHasOptionsTable(L, 1, FN)) reset = LuaInternal::tableOptBool(L, 1, "reset").value_or(false);
+
+	auto dspDebugPerf = [](lua_State* L) -> int {
+		debugPerf(lua_toboolean(L, lua_upvalueindex(1)));
+		return 0;
+	};
+
+	lua_pushboolean(L, reset);
+	lua_pushcclosure(L, dspDebugPerf, 1);
+	return 1;
+}
+
+static SDispatchResult dispatch_debugperf(std::string arg) {
+	return debugPerf(arg == "reset");
+}
+
+// Start recording into `path`, or stop the running recording if `path` is empty.
+static SDispatchResult record(const std::string& path) {
+	if (!path.empty()) {
+		Hy3RecordSnapshot snapshot;
+
+		auto monitor = Desktop::focusState()->monitor();
+		if (monitor && valid(monitor->m_activeWorkspace)) snapshot.focused_workspace = monitor->m_activeWorkspace->m_id;
+
+		for (auto* hy3: g_hy3Instances) {
+			if (auto workspace = hy3->recordSnapshot()) snapshot.workspaces.push_back(std::move(*workspace));
+		}
+
+		if (auto error = Hy3Recorder::start(path, snapshot)) {
+			hy3_log(ERR, "record: {}", *error);
+			return { .success = false, .error = *error };
+		}
+
+		hy3_log(LOG, "recording layout events to {}", path);
+		return SDispatchResult {};
+	}
+
+	if (!Hy3Recorder::active()) return { .success = false, .error = "not recording" };
+	Hy3Recorder::stop();
+	return SDispatchResult {};
+}
+
+static int luaRecord(lua_State* L) {
+	static constexpr const char* FN = "hl.plugin.hy3.record";
+	luaCheckArgCount(L, FN, 0, 1);
+
+	std::string path;
+	if (luaHasOptionsTable(L, 1, FN)) path = LuaInternal::tableOptStr(L, 1, "path").value_or("");
+
+	auto dspRecord = [](lua_State* L) -> int {
+		record(lua_tostring(L, lua_upvalueindex(1)));
+		return 0;
+	};
+
+	lua_pushstring(L, path.c_str());
+	lua_pushcclosure(L, dspRecord, 1);
+	return 1;
+}
+
+static SDispatchResult dispatch_record(std::string value) {
+	auto args = CVarList(value, 2);
+
+	if (args[0] == "start") {
+		if (args[1] == "") return { .success = false, .error = "record: missing path" };
+		return record(args[1]);
+	} else if (args[0] == "stop") {
+		return record("");
+	}
+
+	return { .success = false, .error = std::format("record: invalid action '{}' (expected start/stop)", args[0]) };
+}
+
+// Print event counts and latencies of a recording made with hy3:record.
+static SDispatchResult recordSummary(const std::string& path) {
+	std::vector<Hy3RecordEntry> entries;
+
+	if (auto error = Hy3Recorder::read(path, entries)) {
+		hy3_log(ERR, "recordsummary: {}", *error);
+		return { .success = false, .error = *error };
+	}
+
+	auto output = Hy3Recorder::summaryJson(entries);
+	hy3_log(LOG, "RECORD SUMMARY {}\n{}", path, output);
+	return { .success = false, .error = output };
+}
+
+static SDispatchResult dispatch_recordsummary(std::string value) {
+	if (value == "") return { .success = false, .error = "recordsummary: missing path" };
+	return recordSummary(value);
+}
+
+struct SHy3Dispatcher {
+	const char* name;
+	SDispatchResult (*dispatch)(std::string);
+	// returns its output as the error for hyprctl to print, and changes no layout state
+	bool reports_output = false;
+};
+
+static constexpr SHy3Dispatcher DISPATCHERS[] = {
+    {"makegroup", dispatch_makegroup},
+    {"changegroup", dispatch_changegroup},
+    {"setephemeral", dispatch_setephemeral},
+    {"movefocus", dispatch_movefocus},
+    {"togglefocuslayer", dispatch_togglefocuslayer},
+    {"warpcursor", dispatch_warpcursor},
+    {"movewindow", dispatch_movewindow},
+    {"movetoworkspace", dispatch_move_to_workspace},
+    {"changefocus", dispatch_changefocus},
+    {"focustab", dispatch_focustab},
+    {"setswallow", dispatch_setswallow},
+    {"killactive", dispatch_killactive},
+    {"expand", dispatch_expand},
+    {"locktab", dispatch_locktab},
+    {"equalize", dispatch_equalize},
+    {"debugnodes", dispatch_debug, true},
+    {"debugperf", dispatch_debugperf, true},
+    {"record", dispatch_record},
+    {"recordsummary", dispatch_recordsummary, true},
+};
+
+static std::string_view trimCommand(std::string_view value, std::string_view chars = " \t") {
+	auto start = value.find_first_not_of(chars);
+	if (start == std::string_view::npos) return {};
+	auto end = value.find_last_not_of(chars);
+	return value.substr(start, end - start + 1);
+}
+
+// Split a `;` separated command list into its trimmed, non empty commands.
+static std::vector<std::string_view> splitCommandList(std::string_view list) {
+	std::vector<std::string_view> commands;
+
+	while (!list.empty()) {
+		auto end = list.find(';');
+		auto command = trimCommand(list.substr(0, end));
+		if (!command.empty()) commands.push_back(command);
+		if (end == std::string_view::npos) break;
+		list.remove_prefix(end + 1);
+	}
+
+	return commands;
+}
+
+// Split a command into its dispatcher and arguments, the name may be followed by either
+// a space or a comma.
+static std::optional<std::pair<const SHy3Dispatcher*, std::string>> parseCommand(std::string_view command) {
+	auto name_end = command.find_first_of(" \t,");
+	auto name = command.substr(0, name_end);
+	if (name.starts_with("hy3:")) name.remove_prefix(4);
+
+	auto args = name_end == std::string_view::npos
+	              ? std::string_view()
+	              : trimCommand(command.substr(name_end), " \t,");
+
+	for (auto& dispatcher: DISPATCHERS) {
+		if (name == dispatcher.name) return std::make_pair(&dispatcher, std::string(args));
+	}
+
+	return {};
+}
+
+SDispatchResult runCommandList(std::string_view list, const Hy3CommandBuiltins& builtins) {
+	struct Command {
+		const std::function<void()>* builtin = nullptr;
+		const SHy3Dispatcher* dispatcher = nullptr;
+		std::string args;
+	};
+
+	std::vector<Command> commands;
+
+	// validate the whole list before running any of it
+	for (auto command: splitCommandList(list)) {
+		if (auto it = builtins.find(command); it != builtins.end()) {
+			commands.push_back({.builtin = &it->second});
+			continue;
+		}
+
+		auto parsed = parseCommand(command);
+		if (!parsed) return { .success = false, .error = std::format("unknown command '{}'", command) };
+		commands.push_back({.dispatcher = parsed->first, .args = std::move(parsed->second)});
+	}
+
+	Hy3Batch batch;
+	std::string output;
+
+	for (auto& command: commands) {
+		if (command.builtin != nullptr) {
+			(*command.builtin)();
+			continue;
+		}
+
+		auto result = command.dispatcher->dispatch(command.args);
+
+		if (command.dispatcher->reports_output) {
+			if (!output.empty()) output += "\n";
+			output += result.error;
+		} else if (!result.success) {
+			return { .success = false, .error = std::format("{}: {}", command.dispatcher->name, result.error) };
+		}
+	}
+
+	// passed on the same way the reporting commands return it on their own
+	if (!output.empty()) return { .success = false, .error = output };
+	return SDispatchResult {};
+}
+
+static SDispatchResult dispatch_batch(std::string value) {
+	return runCommandList(value);
+}
+
+static int luaBatch(lua_State* L) {
+	static constexpr const char* FN = "hl.plugin.hy3.batch";
+	luaCheckArgCount(L, FN, 1, 1);
+	if (!lua_istable(L, 1))
+		return luaL_error(L, "%s: expected a table of dispatchers", FN);
+
+	const auto count = lua_rawlen(L, 1);
+	for (size_t i = 1; i <= count; i++) {
+		lua_rawgeti(L, 1, static_cast<lua_Integer>(i));
+		if (!lua_isfunction(L, -1))
+			return luaL_error(L, "%s: entry %d is not a dispatcher", FN, static_cast<int>(i));
+		lua_pop(L, 1);
+	}
+
+	auto dspBatch = [](lua_State* L) -> int {
+		const auto count = lua_rawlen(L, lua_upvalueindex(1));
+		int status = LUA_OK;
+
+		{
+			Hy3Batch batch;
+
+			for (size_t i = 1; i <= count && status == LUA_OK; i++) {
+				lua_rawgeti(L, lua_upvalueindex(1), static_cast<lua_Integer>(i));
+				status = lua_pcall(L, 0, 0, 0);
+			}
+		}
+
+		// raised after the batch has committed what already ran
+		if (status != LUA_OK) return lua_error(L);
+		return 0;
+	};
+
+	lua_pushvalue(L, 1);
+	lua_pushcclosure(L, dspBatch, 1);
+	return 1;
+}
+
 static void registerLuaDispatchers() {
 	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "make_group", luaMakeGroup);
 	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "change_group", luaChangeGroup);
@@ -964,24 +1233,29 @@ static void registerLuaDispatchers() {
 	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "lock_tab", luaLockTab);
 	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "equalize", luaEqualize);
 	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "debug_nodes", luaDebugNodes);
+	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "debug_perf", luaDebugPerf);
+	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "record", luaRecord);
+	HyprlandAPI::addLuaFunction(PHANDLE, "hy3", "batch", luaBatch);
+}
+
+// Run a dispatcher as a recorded Dispatch event, see hy3:record.
+static SDispatchResult dispatchRecorded(const char* name, SDispatchResult (*dispatch)(std::string), std::string args) {
+	Hy3RecordScope record(Hy3RecordEvent::Dispatch);
+	if (Hy3Recorder::active())
+		record.entry.command = args.empty() ? std::string(name) : std::format("{}, {}", name, args);
+
+	return dispatch(std::move(args));
 }
 
 void registerDispatchers() {
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:makegroup", dispatch_makegroup);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:changegroup", dispatch_changegroup);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:setephemeral", dispatch_setephemeral);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:movefocus", dispatch_movefocus);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:togglefocuslayer", dispatch_togglefocuslayer);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:warpcursor", dispatch_warpcursor);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:movewindow", dispatch_movewindow);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:movetoworkspace", dispatch_move_to_workspace);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:changefocus", dispatch_changefocus);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:focustab", dispatch_focustab);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:setswallow", dispatch_setswallow);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:killactive", dispatch_killactive);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:expand", dispatch_expand);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:locktab", dispatch_locktab);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:equalize", dispatch_equalize);
-	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:debugnodes", dispatch_debug);
+	for (auto& dispatcher: DISPATCHERS) {
+		HyprlandAPI::addDispatcherV2(PHANDLE, std::string("hy3:") + dispatcher.name, [&dispatcher](std::string args) {
+			return dispatchRecorded(dispatcher.name, dispatcher.dispatch, std::move(args));
+		});
+	}
+
+	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:batch", [](std::string args) {
+		return dispatchRecorded("batch", dispatch_batch, std::move(args));
+	});
 	registerLuaDispatchers();
 }
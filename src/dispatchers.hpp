@@ -1,3 +1,18 @@
 #pragma once
 
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+
+#include <hyprland/src/plugins/PluginAPI.hpp>
+
 void registerDispatchers();
+
+// Commands run in place of a dispatcher of the same name, such as layoutmsg's togglesplit.
+using Hy3CommandBuiltins = std::unordered_map<std::string_view, std::function<void()>>;
+
+// Run a `;` separated list of hy3 dispatcher commands such as `movefocus, l` or
+// `hy3:makegroup tab` as one batch. The list is validated before any of it runs, and
+// the first failing command ends it with its error. The output of reporting commands
+// like debugnodes is returned as the error, as they return it on their own.
+SDispatchResult runCommandList(std::string_view list, const Hy3CommandBuiltins& builtins = {});
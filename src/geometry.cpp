@@ -0,0 +1,24 @@
+#include "geometry.hpp"
+
+static constexpr double MIN_RATIO = 0.0;
+
+double splitRatioUnit(double extent, size_t child_count, double inter_gap) {
+	if (child_count == 0) return 0;
+	auto constraint = extent - (child_count > 1 ? (child_count - 1) * inter_gap : 0);
+	return constraint / child_count;
+}
+
+std::optional<std::pair<double, double>> resizedSplitRatios(
+    double ratio,
+    double neighbor_ratio,
+    double delta,
+    size_t child_count,
+    double group_extent
+) {
+	auto ratio_mod = delta * (double) child_count / group_extent;
+	auto requested_ratio = ratio + ratio_mod;
+	auto requested_neighbor_ratio = neighbor_ratio - ratio_mod;
+
+	if (requested_ratio < MIN_RATIO || requested_neighbor_ratio < MIN_RATIO) return std::nullopt;
+	return std::make_pair(requested_ratio, requested_neighbor_ratio);
+}
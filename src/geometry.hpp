@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+// Layout math shared by the geometry pass, size prediction and resizing. Free of
+// hyprland types so it is part of hy3core.
+
+struct Hy3Point {
+	double x = 0;
+	double y = 0;
+};
+
+struct Hy3Box {
+	double x = 0;
+	double y = 0;
+	double w = 0;
+	double h = 0;
+
+	bool operator==(const Hy3Box&) const = default;
+};
+
+struct Hy3Size {
+	double w = 0;
+	double h = 0;
+};
+
+struct Hy3Gaps {
+	double top = 0;
+	double right = 0;
+	double bottom = 0;
+	double left = 0;
+};
+
+// Inputs of the geometry pass other than the tree itself.
+struct Hy3GeometryParams {
+	Hy3Gaps gaps_in;
+	// inset of groups with a single child, plugin:hy3:group_inset
+	int group_inset = 0;
+	// space taken by the tab bar above the children of tab groups
+	double tab_offset = 0;
+};
+
+// Size of one unit of size_ratio along the axis of a split group: the extent left
+// after the gaps between its children, shared evenly between them.
+double splitRatioUnit(double extent, size_t child_count, double inter_gap);
+
+// Size ratios of a split child and its neighbor after moving the edge between them
+// by `delta` pixels towards the neighbor, or nullopt if either would become too small.
+std::optional<std::pair<double, double>> resizedSplitRatios(
+    double ratio,
+    double neighbor_ratio,
+    double delta,
+    size_t child_count,
+    double group_extent
+);
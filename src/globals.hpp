@@ -1,6 +1,7 @@
 #pragma once
 
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #include <hyprland/src/desktop/Workspace.hpp>
@@ -8,17 +9,28 @@
 #include <hyprland/src/plugins/PluginAPI.hpp>
 #include <hyprlang.hpp>
 
+#include "Hy3Config.hpp"
 #include "Hy3Layout.hpp"
 #include "TabGroup.hpp"
+#include "log.hpp"
 #include "config/shared/complex/ComplexDataType.hpp"
 
 inline HANDLE PHANDLE = nullptr;
 
+// see Hy3Config::reload
+inline Hy3Config g_config;
+
 // Suppress algorithm callbacks (newTarget/movedTarget/removeTarget) during
 // cross-workspace moves where we manually manage the tree.
 inline bool g_suppressInsert = false;
 
 inline std::set<Hy3Layout*> g_hy3Instances;
+// layouts with a geometry pass scheduled for the next frame
+inline std::set<Hy3Layout*> g_pendingGeometry;
+
+// nesting depth of open Hy3Batch transactions, and the node the last deferred warp targets
+inline size_t g_batchDepth = 0;
+inline Hy3NodeRef g_batchWarp;
 
 inline std::vector<WP<Hy3TabGroup>> g_tabGroups;
 inline std::vector<UP<Hy3TabGroup>> g_destroyingTabGroups;
@@ -27,20 +39,18 @@ inline CHyprSignalListener g_renderListener;
 inline CHyprSignalListener g_tickListener;
 inline CHyprSignalListener g_windowTitleListener;
 inline CHyprSignalListener g_urgentListener;
+inline CHyprSignalListener g_windowActiveListener;
+inline CHyprSignalListener g_mouseButtonListener;
+inline CHyprSignalListener g_configReloadedListener;
+
+// Windows whose title or urgency changed since the last tick. Tab entries showing them
+// are refreshed once per tick instead of once per event.
+inline std::vector<PHLWINDOWREF> g_pendingTabEntryWindows;
+// position of each queued window in g_pendingTabEntryWindows, by address
+inline std::unordered_map<const Desktop::View::CWindow*, size_t> g_pendingTabEntryIndex;
 
 inline Hy3Layout* hy3InstanceForWorkspace(PHLWORKSPACE ws) {
 	if (!ws || !ws->m_space || !ws->m_space->algorithm()) return nullptr;
 	return dynamic_cast<Hy3Layout*>(ws->m_space->algorithm()->tiledAlgo().get());
 }
 
-inline void errorNotif() {
-	HyprlandAPI::addNotificationV2(
-	    PHANDLE,
-	    {
-	        {"text", "Something has gone very wrong. Check the log for details."},
-	        {"time", (uint64_t) 10000},
-	        {"color", CHyprColor(1.0, 0.0, 0.0, 1.0)},
-	        {"icon", ICON_ERROR},
-	    }
-	);
-}
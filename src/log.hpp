@@ -1,20 +1,38 @@
 #pragma once
 
-#include <hyprland/src/debug/log/Logger.hpp>
-#include <hyprutils/cli/Logger.hpp>
+#include <format>
+#include <string>
 
-using Hyprutils::CLI::eLogLevel;
+// Logging shared by the plugin and hy3core. Messages are passed to g_logSink, which the
+// plugin points at hyprland's logger and the tools at stderr, and dropped while unset.
 
-inline constexpr auto TRACE = Log::TRACE;
-inline constexpr auto DEBUG = Log::DEBUG;
-inline constexpr auto INFO  = Log::INFO;
-inline constexpr auto WARN  = Log::WARN;
-inline constexpr auto ERR   = Log::ERR;
-inline constexpr auto CRIT  = Log::CRIT;
-inline constexpr auto LOG  = Log::DEBUG;
+enum class Hy3LogLevel {
+	Trace,
+	Debug,
+	Info,
+	Warn,
+	Err,
+	Crit,
+};
+
+inline constexpr auto TRACE = Hy3LogLevel::Trace;
+inline constexpr auto DEBUG = Hy3LogLevel::Debug;
+inline constexpr auto INFO  = Hy3LogLevel::Info;
+inline constexpr auto WARN  = Hy3LogLevel::Warn;
+inline constexpr auto ERR   = Hy3LogLevel::Err;
+inline constexpr auto CRIT  = Hy3LogLevel::Crit;
+inline constexpr auto LOG  = Hy3LogLevel::Debug;
+
+inline void (*g_logSink)(Hy3LogLevel level, const std::string& message) = nullptr;
+// Called after logging an error the user should be told about.
+inline void (*g_errorNotifier)() = nullptr;
 
 template <typename... Args>
-void hy3_log(eLogLevel level, std::format_string<Args...> fmt, Args&&... args) {
-	auto msg = std::vformat(fmt.get(), std::make_format_args(args...));
-	Log::logger->log(level, "[hy3] {}", msg);
+void hy3_log(Hy3LogLevel level, std::format_string<Args...> fmt, Args&&... args) {
+	if (g_logSink == nullptr) return;
+	g_logSink(level, std::vformat(fmt.get(), std::make_format_args(args...)));
+}
+
+inline void errorNotif() {
+	if (g_errorNotifier != nullptr) g_errorNotifier();
 }
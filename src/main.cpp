@@ -1,4 +1,5 @@
 #include <hyprland/src/Compositor.hpp>
+#include <hyprland/src/debug/log/Logger.hpp>
 #include <hyprland/src/config/values/ConfigValues.hpp>
 #include <hyprland/src/plugins/PluginAPI.hpp>
 #include <hyprland/src/render/Renderer.hpp>
@@ -6,13 +7,70 @@
 #include <hyprland/src/version.h>
 
 #include "dispatchers.hpp"
+#include "Hy3WindowNode.hpp"
 #include "globals.hpp"
+#include "log.hpp"
 #include "TabGroup.hpp"
 
 APICALL EXPORT std::string PLUGIN_API_VERSION() { return HYPRLAND_API_VERSION; }
 
+static void logToHyprland(Hy3LogLevel level, const std::string& message) {
+	auto hypr_level = Log::DEBUG;
+
+	switch (level) {
+	case Hy3LogLevel::Trace: hypr_level = Log::TRACE; break;
+	case Hy3LogLevel::Debug: hypr_level = Log::DEBUG; break;
+	case Hy3LogLevel::Info: hypr_level = Log::INFO; break;
+	case Hy3LogLevel::Warn: hypr_level = Log::WARN; break;
+	case Hy3LogLevel::Err: hypr_level = Log::ERR; break;
+	case Hy3LogLevel::Crit: hypr_level = Log::CRIT; break;
+	}
+
+	Log::logger->log(hypr_level, "[hy3] {}", message);
+}
+
+static void notifyError() {
+	HyprlandAPI::addNotificationV2(
+	    PHANDLE,
+	    {
+	        {"text", "Something has gone very wrong. Check the log for details."},
+	        {"time", (uint64_t) 10000},
+	        {"color", CHyprColor(1.0, 0.0, 0.0, 1.0)},
+	        {"icon", ICON_ERROR},
+	    }
+	);
+}
+
+static void queueTabEntryUpdate(const PHLWINDOW& window) {
+	auto [it, inserted] = g_pendingTabEntryIndex.try_emplace(window.get(), g_pendingTabEntryWindows.size());
+
+	// the address may belong to a window freed since it was queued, keep the live one
+	if (!inserted) g_pendingTabEntryWindows[it->second] = window;
+	else g_pendingTabEntryWindows.emplace_back(window);
+}
+
+static void flushPendingTabEntries() {
+	if (g_pendingTabEntryWindows.empty()) return;
+
+	for (auto& ref: g_pendingTabEntryWindows) {
+		auto window = ref.lock();
+		if (!window) continue;
+		auto* hy3 = hy3InstanceForWorkspace(window->m_workspace);
+		if (!hy3) continue;
+		auto* node = hy3->getNodeFromWindow(window.get());
+		if (!node) continue;
+		node->invalidateAggregates();
+		updateTabEntries(*node);
+	}
+
+	g_pendingTabEntryWindows.clear();
+	g_pendingTabEntryIndex.clear();
+}
+
 APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	PHANDLE = handle;
+	g_logSink = logToHyprland;
+	g_errorNotifier = notifyError;
 
 #ifndef HY3_NO_VERSION_CHECK
 	const std::string COMPOSITOR_HASH = __hyprland_api_get_hash();
@@ -50,6 +108,7 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	CONF("tabs:text_font", String, "Sans");
 	CONF("tabs:text_height", Int, 8);
 	CONF("tabs:text_padding", Int, 3);
+	CONF("tabs:text_min_rerender_interval", Int, 0);
 	CONF("tabs:opacity", Float, 1.0);
 	CONF("tabs:blur", Bool, true);
 	CONF("tabs:colors:active", Color, 0x4033ccff);
@@ -78,6 +137,10 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	CONF("autotile:trigger_width", Int, 0);
 	CONF("autotile:workspaces", String, "all");
 
+	// debug
+	CONF("debug:perf_stats", Bool, false);
+	CONF("debug:check_invariants", Bool, false);
+
 #undef CONF
 
 	HyprlandAPI::addTiledAlgo(PHANDLE, "hy3", &typeid(Hy3Layout), []() -> UP<Layout::ITiledAlgorithm> {
@@ -89,6 +152,7 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 		static std::vector<Hy3TabGroup*> rendered_groups;
 
 		switch (stage) {
+		case RENDER_PRE: Hy3Layout::flushAllGeometry(); break;
 		case RENDER_PRE_WINDOWS:
 			rendering_normally = true;
 			rendered_groups.clear();
@@ -115,6 +179,8 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	});
 
 	g_tickListener = Event::bus()->m_events.tick.listen([]() {
+		flushPendingTabEntries();
+
 		for (auto& wp: g_tabGroups) {
 			if (auto* tg = wp.get()) tg->tick();
 		}
@@ -124,26 +190,34 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 
 	g_windowTitleListener = Event::bus()->m_events.window.title.listen([](PHLWINDOW window) {
 		if (!window) return;
-		auto* hy3 = hy3InstanceForWorkspace(window->m_workspace);
-		if (!hy3) return;
-		auto* node = hy3->getNodeFromWindow(window.get());
-		if (!node) return;
-		node->updateTabBarRecursive();
+		queueTabEntryUpdate(window);
 	});
 
 	g_urgentListener = Event::bus()->m_events.window.urgent.listen([](PHLWINDOW window) {
 		if (!window) return;
 		window->m_isUrgent = true;
-		auto* hy3 = hy3InstanceForWorkspace(window->m_workspace);
-		if (!hy3) return;
-		auto* node = hy3->getNodeFromWindow(window.get());
-		if (!node) return;
-		node->updateTabBarRecursive();
+		queueTabEntryUpdate(window);
+	});
+
+	g_windowActiveListener = Event::bus()->m_events.window.active.listen(
+	    [](PHLWINDOW window, Desktop::eFocusReason) { Hy3Layout::onWindowActive(window); }
+	);
+
+	g_mouseButtonListener = Event::bus()->m_events.input.mouse.button.listen(
+	    [](IPointer::SButtonEvent event, Event::SCallbackInfo& info) {
+		    Hy3Layout::onMouseButton(event, info);
+	    }
+	);
+
+	g_configReloadedListener = Event::bus()->m_events.config.reloaded.listen([]() {
+		Hy3Config::reload();
+		for (auto* hy3: g_hy3Instances) hy3->onConfigReloaded();
 	});
 
 	registerDispatchers();
 
 	HyprlandAPI::reloadConfig();
+	Hy3Config::reload();
 
 	return {"hy3", "i3 like layout for hyprland", "outfoxxed", "0.1"};
 }
@@ -153,6 +227,12 @@ APICALL EXPORT void PLUGIN_EXIT() {
 	g_tickListener.reset();
 	g_windowTitleListener.reset();
 	g_urgentListener.reset();
+	g_windowActiveListener.reset();
+	g_mouseButtonListener.reset();
+	g_configReloadedListener.reset();
+	g_pendingTabEntryWindows.clear();
+	g_pendingTabEntryIndex.clear();
+	g_pendingGeometry.clear();
 
 	g_tabGroups.clear();
 	g_destroyingTabGroups.clear();
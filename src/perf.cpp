@@ -0,0 +1,95 @@
+#include "perf.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+
+#include "NodePool.hpp"
+
+bool Hy3Perf::enabled = false;
+std::array<Hy3PerfCounter, static_cast<size_t>(Hy3PerfOp::Count)> Hy3Perf::counters;
+
+static const char* opName(Hy3PerfOp op) {
+	switch (op) {
+	case Hy3PerfOp::GeometryPass: return "geometry_pass";
+	case Hy3PerfOp::InsertNode: return "insert_node";
+	case Hy3PerfOp::ShiftOrGetFocus: return "shift_or_get_focus";
+	case Hy3PerfOp::ExtractAndMerge: return "extract_and_merge";
+	case Hy3PerfOp::GetNodeFromWindow: return "get_node_from_window";
+	case Hy3PerfOp::DebugNodes: return "debug_nodes";
+	case Hy3PerfOp::Count: break;
+	}
+
+	return "unknown";
+}
+
+void Hy3PerfCounter::record(uint64_t ns, uint64_t allocations) {
+	this->count++;
+	this->total_ns += ns;
+	this->allocations += allocations;
+	if (ns > this->max_ns) this->max_ns = ns;
+
+	auto bucket = std::bit_width(ns);
+	if (bucket >= this->buckets.size()) bucket = this->buckets.size() - 1;
+	this->buckets[bucket]++;
+}
+
+uint64_t Hy3PerfCounter::percentile(double fraction) const {
+	if (this->count == 0) return 0;
+
+	auto target = static_cast<uint64_t>(fraction * this->count);
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < this->buckets.size(); i++) {
+		seen += this->buckets[i];
+		// the max is a tighter bound for the last bucket
+		if (seen > target) return std::min(this->max_ns, uint64_t(1) << i);
+	}
+
+	return this->max_ns;
+}
+
+void Hy3Perf::reset() { counters = {}; }
+
+std::string Hy3Perf::reportJson() {
+	std::string json = "{";
+
+	for (size_t i = 0; i < counters.size(); i++) {
+		auto& counter = counters[i];
+		auto ops = counter.count == 0 ? 1.0 : static_cast<double>(counter.count);
+
+		json += std::format(
+		    "{}\"{}\":{{\"count\":{},\"ns_per_op\":{:.1f},\"allocs_per_op\":{:.2f},"
+		    "\"p50_ns\":{},\"p90_ns\":{},\"p99_ns\":{},\"max_ns\":{}}}",
+		    i == 0 ? "" : ",",
+		    opName(static_cast<Hy3PerfOp>(i)),
+		    counter.count,
+		    counter.total_ns / ops,
+		    counter.allocations / ops,
+		    counter.percentile(0.5),
+		    counter.percentile(0.9),
+		    counter.percentile(0.99),
+		    counter.max_ns
+		);
+	}
+
+	return json + "}";
+}
+
+Hy3PerfScope::Hy3PerfScope(Hy3PerfOp op): op(op), active(Hy3Perf::enabled) {
+	if (!this->active) return;
+	this->allocations = Hy3NodePool::totalAllocations();
+	this->start = std::chrono::steady_clock::now();
+}
+
+Hy3PerfScope::~Hy3PerfScope() {
+	if (!this->active) return;
+
+	auto elapsed = std::chrono::steady_clock::now() - this->start;
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+	Hy3Perf::counters[static_cast<size_t>(this->op)].record(
+	    static_cast<uint64_t>(ns),
+	    Hy3NodePool::totalAllocations() - this->allocations
+	);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Latency and allocation counters for layout operations, reported by hy3:debugperf.
+// Only recorded while Hy3Perf::enabled is set (plugin:hy3:debug:perf_stats).
+
+enum class Hy3PerfOp {
+	GeometryPass,
+	InsertNode,
+	ShiftOrGetFocus,
+	ExtractAndMerge,
+	GetNodeFromWindow,
+	DebugNodes,
+	Count,
+};
+
+struct Hy3PerfCounter {
+	uint64_t count = 0;
+	uint64_t total_ns = 0;
+	uint64_t max_ns = 0;
+	uint64_t allocations = 0;
+	// bucket i counts operations that took less than 2^i ns
+	std::array<uint64_t, 64> buckets {};
+
+	void record(uint64_t ns, uint64_t allocations);
+	// Upper bound of the bucket containing the given fraction of operations.
+	uint64_t percentile(double fraction) const;
+};
+
+class Hy3Perf {
+public:
+	static bool enabled;
+
+	static void reset();
+	// All counters as a JSON object keyed by operation name.
+	static std::string reportJson();
+
+private:
+	static std::array<Hy3PerfCounter, static_cast<size_t>(Hy3PerfOp::Count)> counters;
+
+	friend class Hy3PerfScope;
+};
+
+// Records the duration and node allocations of the enclosing scope.
+class Hy3PerfScope {
+public:
+	explicit Hy3PerfScope(Hy3PerfOp op);
+	~Hy3PerfScope();
+
+	Hy3PerfScope(const Hy3PerfScope&) = delete;
+	Hy3PerfScope& operator=(const Hy3PerfScope&) = delete;
+
+private:
+	Hy3PerfOp op;
+	bool active;
+	size_t allocations = 0;
+	std::chrono::steady_clock::time_point start;
+};
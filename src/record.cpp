@@ -0,0 +1,462 @@
+#include "record.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#include "perf.hpp"
+
+static constexpr char MAGIC[4] = {'H', 'Y', '3', 'R'};
+static constexpr uint8_t VERSION = 2;
+// first version with a snapshot header
+static constexpr uint8_t SNAPSHOT_VERSION = 2;
+// deeper snapshot trees are rejected as malformed
+static constexpr size_t MAX_SNAPSHOT_DEPTH = 256;
+
+static struct {
+	std::ofstream file;
+	std::chrono::steady_clock::time_point start;
+	int64_t last_start_ns = 0;
+	uint8_t depth = 0;
+	uint64_t next_window = 1;
+	std::unordered_map<const void*, uint64_t> windows;
+} recording;
+
+const char* Hy3Recorder::eventName(Hy3RecordEvent event) {
+	switch (event) {
+	case Hy3RecordEvent::NewTarget: return "new_target";
+	case Hy3RecordEvent::RemoveTarget: return "remove_target";
+	case Hy3RecordEvent::MovedTarget: return "moved_target";
+	case Hy3RecordEvent::ResizeTarget: return "resize_target";
+	case Hy3RecordEvent::FocusChange: return "focus_change";
+	case Hy3RecordEvent::Dispatch: return "dispatch";
+	case Hy3RecordEvent::Count: break;
+	}
+
+	return "unknown";
+}
+
+static void putVarint(std::string& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back(static_cast<char>(value));
+}
+
+static void putZigzag(std::string& out, int64_t value) {
+	putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+static void putFloat(std::string& out, float value) {
+	auto bits = std::bit_cast<uint32_t>(value);
+	for (int i = 0; i < 4; i++) out.push_back(static_cast<char>(bits >> (i * 8)));
+}
+
+static void putBox(std::string& out, const Hy3Box& box) {
+	putFloat(out, box.x);
+	putFloat(out, box.y);
+	putFloat(out, box.w);
+	putFloat(out, box.h);
+}
+
+static uint64_t windowId(const void* window) {
+	auto [it, inserted] = recording.windows.try_emplace(window, recording.next_window);
+	if (inserted) recording.next_window++;
+	return it->second;
+}
+
+static void putNode(std::string& out, const Hy3RecordNode& node) {
+	out.push_back(node.group ? 1 : 0);
+	putFloat(out, node.size_ratio);
+
+	if (!node.group) {
+		putVarint(out, windowId(node.window_key));
+		putBox(out, node.box);
+		return;
+	}
+
+	out.push_back(static_cast<char>(node.layout));
+	out.push_back(static_cast<char>(node.ephemeral));
+	out.push_back(static_cast<char>(node.expand_focused));
+	out.push_back(
+	    static_cast<char>((node.group_focused ? 1 : 0) | (node.locked ? 2 : 0) | (node.containment ? 4 : 0))
+	);
+	putZigzag(out, node.focused_child);
+	putVarint(out, node.children.size());
+
+	for (auto& child: node.children) {
+		putNode(out, child);
+	}
+}
+
+// Reads the encoding above from a buffer, any read past the end marks it as failed.
+struct Hy3RecordCursor {
+	const std::string& data;
+	size_t pos = 0;
+	bool failed = false;
+
+	bool done() const { return this->failed || this->pos >= this->data.size(); }
+
+	uint8_t byte() {
+		if (this->pos >= this->data.size()) {
+			this->failed = true;
+			return 0;
+		}
+
+		return static_cast<uint8_t>(this->data[this->pos++]);
+	}
+
+	uint64_t varint() {
+		uint64_t value = 0;
+
+		for (int shift = 0; shift < 64; shift += 7) {
+			auto b = this->byte();
+			value |= static_cast<uint64_t>(b & 0x7f) << shift;
+			if ((b & 0x80) == 0) return value;
+		}
+
+		this->failed = true;
+		return value;
+	}
+
+	int64_t zigzag() {
+		auto value = this->varint();
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	float f32() {
+		uint32_t bits = 0;
+		for (int i = 0; i < 4; i++) bits |= static_cast<uint32_t>(this->byte()) << (i * 8);
+		return std::bit_cast<float>(bits);
+	}
+
+	Hy3Box box() {
+		auto x = this->f32();
+		auto y = this->f32();
+		auto w = this->f32();
+		return Hy3Box {x, y, w, this->f32()};
+	}
+
+	// Read an enum stored as a byte, failing on values above `last`.
+	template <typename T>
+	T enumByte(T last) {
+		auto value = this->byte();
+		if (value > static_cast<uint8_t>(last)) this->failed = true;
+		return static_cast<T>(value);
+	}
+
+	void node(Hy3RecordNode& node, size_t depth) {
+		if (depth > MAX_SNAPSHOT_DEPTH) {
+			this->failed = true;
+			return;
+		}
+
+		node.group = this->byte() != 0;
+		node.size_ratio = this->f32();
+
+		if (!node.group) {
+			node.window = this->varint();
+			node.box = this->box();
+			return;
+		}
+
+		node.layout = this->enumByte(Hy3GroupLayout::Tabbed);
+		node.ephemeral = this->enumByte(Ephemeral::Active);
+		node.expand_focused = this->enumByte(ExpandFocusType::Stack);
+
+		auto flags = this->byte();
+		node.group_focused = flags & 1;
+		node.locked = flags & 2;
+		node.containment = flags & 4;
+		node.focused_child = this->zigzag();
+
+		// every child takes at least one byte
+		auto count = this->varint();
+		if (count > this->data.size() - std::min(this->pos, this->data.size())) {
+			this->failed = true;
+			return;
+		}
+
+		node.children.resize(count);
+		for (auto& child: node.children) {
+			if (this->failed) return;
+			this->node(child, depth + 1);
+		}
+
+		if (node.focused_child < -1 || node.focused_child >= static_cast<int64_t>(count)) this->failed = true;
+	}
+
+	void snapshot(Hy3RecordSnapshot& snapshot) {
+		snapshot.focused_workspace = this->zigzag();
+
+		auto count = this->varint();
+		if (count > this->data.size() - std::min(this->pos, this->data.size())) {
+			this->failed = true;
+			return;
+		}
+
+		snapshot.workspaces.resize(count);
+
+		for (auto& workspace: snapshot.workspaces) {
+			if (this->failed) return;
+
+			workspace.id = this->zigzag();
+			workspace.area = this->box();
+			workspace.offsets = this->box();
+			workspace.params.gaps_in.top = this->f32();
+			workspace.params.gaps_in.right = this->f32();
+			workspace.params.gaps_in.bottom = this->f32();
+			workspace.params.gaps_in.left = this->f32();
+			workspace.params.group_inset = static_cast<int>(this->zigzag());
+			workspace.params.tab_offset = this->f32();
+			this->node(workspace.root, 0);
+		}
+	}
+};
+
+std::optional<std::string> Hy3Recorder::start(const std::string& path, const Hy3RecordSnapshot& snapshot) {
+	stop();
+
+	recording.file.open(path, std::ios::binary | std::ios::trunc);
+	if (!recording.file) return std::format("could not open '{}'", path);
+
+	recording.depth = 0;
+	recording.next_window = 1;
+	recording.windows.clear();
+
+	std::string out(MAGIC, sizeof(MAGIC));
+	out.push_back(static_cast<char>(VERSION));
+	putZigzag(out, snapshot.focused_workspace);
+	putVarint(out, snapshot.workspaces.size());
+
+	for (auto& workspace: snapshot.workspaces) {
+		putZigzag(out, workspace.id);
+		putBox(out, workspace.area);
+		putBox(out, workspace.offsets);
+		putFloat(out, workspace.params.gaps_in.top);
+		putFloat(out, workspace.params.gaps_in.right);
+		putFloat(out, workspace.params.gaps_in.bottom);
+		putFloat(out, workspace.params.gaps_in.left);
+		putZigzag(out, workspace.params.group_inset);
+		putFloat(out, workspace.params.tab_offset);
+		putNode(out, workspace.root);
+	}
+
+	recording.file.write(out.data(), static_cast<std::streamsize>(out.size()));
+
+	recording.start = std::chrono::steady_clock::now();
+	recording.last_start_ns = 0;
+	return std::nullopt;
+}
+
+void Hy3Recorder::stop() {
+	if (!recording.file.is_open()) return;
+
+	recording.file.close();
+	recording.depth = 0;
+	recording.windows.clear();
+}
+
+bool Hy3Recorder::active() { return recording.file.is_open(); }
+
+Hy3RecordNode Hy3Recorder::capture(Hy3Node& node, const void* (*window_key)(Hy3TargetNode&)) {
+	Hy3RecordNode record {.group = node.is_group(), .size_ratio = node.size_ratio};
+
+	if (!node.is_group()) {
+		record.window_key = window_key(node.as_target_node());
+		record.box = node.visualBox;
+		return record;
+	}
+
+	auto& group = node.as_group();
+	record.layout = group.layout;
+	record.ephemeral = group.ephemeral;
+	record.expand_focused = group.expand_focused;
+	record.group_focused = group.group_focused;
+	record.locked = group.locked;
+	record.containment = group.containment;
+	record.children.reserve(group.children.size());
+
+	for (auto& child: group.children) {
+		if (child.get() == group.focused_child) record.focused_child = record.children.size();
+		record.children.push_back(capture(*child, window_key));
+	}
+
+	return record;
+}
+
+void Hy3Recorder::write(Hy3RecordEntry& entry, const void* window) {
+	if (window != nullptr) {
+		entry.window = windowId(window);
+
+		// the address may be reused by a later window
+		if (entry.event == Hy3RecordEvent::RemoveTarget) recording.windows.erase(window);
+	}
+
+	std::string out;
+	out.push_back(static_cast<char>(entry.event));
+	out.push_back(static_cast<char>(entry.depth));
+	putZigzag(out, entry.start_ns - recording.last_start_ns);
+	putVarint(out, entry.duration_ns);
+	putVarint(out, entry.window);
+	putZigzag(out, entry.workspace);
+
+	switch (entry.event) {
+	case Hy3RecordEvent::MovedTarget:
+		out.push_back(entry.point ? 1 : 0);
+		if (entry.point) {
+			putFloat(out, entry.point->first);
+			putFloat(out, entry.point->second);
+		}
+		break;
+	case Hy3RecordEvent::ResizeTarget:
+		putFloat(out, entry.point ? entry.point->first : 0.0f);
+		putFloat(out, entry.point ? entry.point->second : 0.0f);
+		out.push_back(static_cast<char>(entry.corner));
+		break;
+	case Hy3RecordEvent::Dispatch:
+		putVarint(out, entry.command.size());
+		out += entry.command;
+		break;
+	default: break;
+	}
+
+	recording.last_start_ns = entry.start_ns;
+	recording.file.write(out.data(), static_cast<std::streamsize>(out.size()));
+}
+
+std::optional<std::string> Hy3Recorder::read(
+    const std::string& path,
+    std::vector<Hy3RecordEntry>& entries,
+    Hy3RecordSnapshot* snapshot
+) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return std::format("could not open '{}'", path);
+
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (data.size() < sizeof(MAGIC) + 1 || data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0)
+		return std::format("'{}' is not a hy3 recording", path);
+
+	auto version = static_cast<uint8_t>(data[sizeof(MAGIC)]);
+	if (version == 0 || version > VERSION)
+		return std::format("'{}' has unsupported version {}", path, version);
+
+	Hy3RecordCursor cursor {.data = data, .pos = sizeof(MAGIC) + 1};
+	int64_t last_start_ns = 0;
+
+	if (version >= SNAPSHOT_VERSION) {
+		Hy3RecordSnapshot read_snapshot;
+		cursor.snapshot(read_snapshot);
+		if (cursor.failed) return std::format("'{}' has a malformed snapshot", path);
+		if (snapshot != nullptr) *snapshot = std::move(read_snapshot);
+	}
+
+	while (!cursor.done()) {
+		auto offset = cursor.pos;
+		Hy3RecordEntry entry;
+
+		auto event = cursor.byte();
+		if (event >= static_cast<uint8_t>(Hy3RecordEvent::Count))
+			return std::format("unknown event type {} at offset {}", event, offset);
+
+		entry.event = static_cast<Hy3RecordEvent>(event);
+		entry.depth = cursor.byte();
+		entry.start_ns = last_start_ns + cursor.zigzag();
+		entry.duration_ns = cursor.varint();
+		entry.window = cursor.varint();
+		entry.workspace = cursor.zigzag();
+
+		switch (entry.event) {
+		case Hy3RecordEvent::MovedTarget:
+			if (cursor.byte() != 0) {
+				auto x = cursor.f32();
+				entry.point = std::make_pair(x, cursor.f32());
+			}
+			break;
+		case Hy3RecordEvent::ResizeTarget: {
+			auto x = cursor.f32();
+			entry.point = std::make_pair(x, cursor.f32());
+			entry.corner = cursor.byte();
+		} break;
+		case Hy3RecordEvent::Dispatch: {
+			auto length = cursor.varint();
+			if (length > data.size() - cursor.pos) {
+				cursor.failed = true;
+				break;
+			}
+
+			entry.command = data.substr(cursor.pos, length);
+			cursor.pos += length;
+		} break;
+		default: break;
+		}
+
+		if (cursor.failed) return std::format("truncated event at offset {}", offset);
+
+		last_start_ns = entry.start_ns;
+		entries.push_back(std::move(entry));
+	}
+
+	return std::nullopt;
+}
+
+std::string Hy3Recorder::summaryJson(const std::vector<Hy3RecordEntry>& entries) {
+	std::array<Hy3PerfCounter, static_cast<size_t>(Hy3RecordEvent::Count)> counters;
+
+	for (auto& entry: entries) {
+		counters[static_cast<size_t>(entry.event)].record(entry.duration_ns, 0);
+	}
+
+	std::string json = "{";
+
+	for (size_t i = 0; i < counters.size(); i++) {
+		auto& counter = counters[i];
+		auto ops = counter.count == 0 ? 1.0 : static_cast<double>(counter.count);
+
+		json += std::format(
+		    "{}\"{}\":{{\"count\":{},\"ns_per_op\":{:.1f},\"p50_ns\":{},\"p99_ns\":{},\"max_ns\":{}}}",
+		    i == 0 ? "" : ",",
+		    eventName(static_cast<Hy3RecordEvent>(i)),
+		    counter.count,
+		    counter.total_ns / ops,
+		    counter.percentile(0.5),
+		    counter.percentile(0.99),
+		    counter.max_ns
+		);
+	}
+
+	return json + "}";
+}
+
+Hy3RecordScope::Hy3RecordScope(Hy3RecordEvent event, const void* window, int64_t workspace)
+    : active(Hy3Recorder::active())
+    , window(window) {
+	if (!this->active) return;
+
+	this->entry.event = event;
+	this->entry.workspace = workspace;
+	this->entry.depth = recording.depth++;
+	this->start = std::chrono::steady_clock::now();
+}
+
+Hy3RecordScope::~Hy3RecordScope() {
+	if (!this->active) return;
+
+	// recording may have been stopped, or restarted, by this very event
+	if (recording.depth == 0 || !Hy3Recorder::active()) return;
+	recording.depth--;
+
+	auto end = std::chrono::steady_clock::now();
+	this->entry.start_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(this->start - recording.start).count();
+	this->entry.duration_ns =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(end - this->start).count();
+
+	Hy3Recorder::write(this->entry, this->window);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Hy3Node.hpp"
+#include "geometry.hpp"
+
+// Recording of the layout events and hy3 dispatcher calls, started with hy3:record.
+// A snapshot of every workspace is written when recording starts, and events are
+// written to a compact binary log as they finish:
+//
+//   header:    "HY3R" u8 version, snapshot (version 2 and later)
+//   snapshot:  zigzag varint focused workspace id, varint workspace count, workspace...
+//   workspace: zigzag varint id, box area, box offsets, f32 gaps top/right/bottom/left,
+//              zigzag varint group inset, f32 tab offset, node
+//   node:      u8 is group, f32 size ratio, followed by
+//              target: varint window id, box visual box
+//              group:  u8 layout, u8 ephemeral, u8 expand focused,
+//                      u8 flags (1 group focused, 2 locked, 4 containment),
+//                      zigzag varint focused child index or -1, varint child count, node...
+//   box:       f32 x, f32 y, f32 w, f32 h
+//   event:     u8 type, u8 depth, zigzag varint start delta (ns), varint duration (ns),
+//           varint window id, zigzag varint workspace id, followed by
+//           MovedTarget:  u8 has focal point, [f32 x, f32 y]
+//           ResizeTarget: f32 x, f32 y, u8 corner
+//           Dispatch:     varint length, command
+//
+// Start deltas are relative to the previously written event and may be negative, as
+// nested events (for example a focus change caused by a dispatcher) finish first.
+// Window ids are assigned in order of first appearance, starting with the targets of the
+// snapshot, and dropped on RemoveTarget.
+
+enum class Hy3RecordEvent : uint8_t {
+	NewTarget,
+	RemoveTarget,
+	MovedTarget,
+	ResizeTarget,
+	FocusChange,
+	Dispatch,
+	Count,
+};
+
+struct Hy3RecordEntry {
+	Hy3RecordEvent event = Hy3RecordEvent::Dispatch;
+	// number of enclosing events still running when this one started
+	uint8_t depth = 0;
+	// relative to the start of the recording
+	int64_t start_ns = 0;
+	uint64_t duration_ns = 0;
+	uint64_t window = 0;
+	int64_t workspace = -1;
+	// focal point of MovedTarget, delta of ResizeTarget
+	std::optional<std::pair<float, float>> point;
+	uint8_t corner = 0;
+	// dispatcher and arguments of Dispatch
+	std::string command;
+};
+
+// A node of a workspace tree at the start of a recording.
+struct Hy3RecordNode {
+	bool group = false;
+	float size_ratio = 1.0;
+
+	// targets. the window key is set when capturing, the id when reading back
+	const void* window_key = nullptr;
+	uint64_t window = 0;
+	Hy3Box box;
+
+	// groups
+	Hy3GroupLayout layout = Hy3GroupLayout::SplitH;
+	Ephemeral ephemeral = Ephemeral::Off;
+	ExpandFocusType expand_focused = ExpandFocusType::NotExpanded;
+	bool group_focused = false;
+	bool locked = false;
+	bool containment = false;
+	int64_t focused_child = -1;
+	std::vector<Hy3RecordNode> children;
+};
+
+struct Hy3RecordWorkspace {
+	int64_t id = -1;
+	// box of the root node and offsets of the last geometry pass
+	Hy3Box area;
+	Hy3Box offsets;
+	Hy3GeometryParams params;
+	Hy3RecordNode root;
+};
+
+struct Hy3RecordSnapshot {
+	int64_t focused_workspace = -1;
+	std::vector<Hy3RecordWorkspace> workspaces;
+};
+
+class Hy3Recorder {
+public:
+	// Start recording with the given state of the workspaces. Returns an error message if
+	// the file could not be opened.
+	static std::optional<std::string> start(const std::string& path, const Hy3RecordSnapshot& snapshot);
+	static void stop();
+	static bool active();
+
+	// Capture a tree for the snapshot. `window_key` returns the window passed to the
+	// Hy3RecordScopes of a target.
+	static Hy3RecordNode capture(Hy3Node& node, const void* (*window_key)(Hy3TargetNode&));
+
+	// Read a recording back, returns an error message if it is malformed. Recordings
+	// made before snapshots were added read back with an empty snapshot.
+	static std::optional<std::string> read(
+	    const std::string& path,
+	    std::vector<Hy3RecordEntry>& entries,
+	    Hy3RecordSnapshot* snapshot = nullptr
+	);
+	static const char* eventName(Hy3RecordEvent event);
+	// Event counts and latencies of a recording as a JSON object keyed by event name.
+	static std::string summaryJson(const std::vector<Hy3RecordEntry>& entries);
+
+private:
+	static void write(Hy3RecordEntry& entry, const void* window);
+
+	friend class Hy3RecordScope;
+};
+
+// Records an event spanning the enclosing scope. Fields of `entry` other than the
+// timing and window id may be filled in before the scope ends.
+class Hy3RecordScope {
+public:
+	explicit Hy3RecordScope(Hy3RecordEvent event, const void* window = nullptr, int64_t workspace = -1);
+	~Hy3RecordScope();
+
+	Hy3RecordScope(const Hy3RecordScope&) = delete;
+	Hy3RecordScope& operator=(const Hy3RecordScope&) = delete;
+
+	Hy3RecordEntry entry;
+
+private:
+	bool active;
+	const void* window;
+	std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,71 @@
+// A focus change must only recalculate the nodes whose geometry it moves, not the whole
+// tree: nothing in a split, the old and new focused children of a tab group.
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Hy3Tree.hpp"
+#include "fakes.hpp"
+
+static constexpr size_t target_count = 100;
+static constexpr size_t max_pass_nodes = 10;
+
+static int failures = 0;
+
+static void fail(const char* name, size_t step, const char* what) {
+	std::fprintf(stderr, "FAIL %s: step %zu: %s\n", name, step, what);
+	failures++;
+}
+
+// Focus random targets of a flat group, by id and by direction, and check the geometry
+// pass that follows every change.
+static void checkFocusPasses(const char* name, Hy3GroupLayout layout) {
+	Hy3FakeHost host;
+	host.first_layout = layout;
+
+	std::vector<Hy3FakeTarget*> targets;
+	for (size_t i = 0; i < target_count; i++) targets.push_back(&host.insert(i + 1));
+	host.flushGeometry();
+
+	std::mt19937_64 rng(1);
+	auto failures_before = failures;
+	size_t worst = 0;
+
+	for (size_t step = 0; step < 200; step++) {
+		auto* focus = targets[rng() % targets.size()];
+
+		if (step % 2 == 0) {
+			focus->markFocused();
+		} else {
+			auto direction = static_cast<ShiftDirection>(rng() % 4);
+			auto& old_focus = *host.focusedNode();
+			auto result = shiftOrGetFocus(old_focus, direction, false, false, false, CollapsePolicy::EmptySplits);
+			if (result.focus == nullptr) continue;
+			result.focus->markFocused();
+			focus = static_cast<Hy3FakeTarget*>(&result.focus->getFocusedNode().as_target_node());
+		}
+
+		// see Hy3Layout::onFocusChanged
+		host.recalcGeometry();
+		host.flushGeometry();
+
+		if (host.last_pass_nodes >= max_pass_nodes) {
+			std::fprintf(stderr, "  recalculated %zu nodes\n", host.last_pass_nodes);
+			fail(name, step, "focus change recalculated too many nodes");
+		}
+
+		if (focus->is_hidden) fail(name, step, "focused target is hidden");
+		if (host.last_pass_nodes > worst) worst = host.last_pass_nodes;
+	}
+
+	if (failures == failures_before) std::printf("ok %s: at most %zu nodes per focus change\n", name, worst);
+}
+
+int main() {
+	checkFocusPasses("splith", Hy3GroupLayout::SplitH);
+	checkFocusPasses("splitv", Hy3GroupLayout::SplitV);
+	checkFocusPasses("tabbed", Hy3GroupLayout::Tabbed);
+
+	return failures == 0 ? 0 : 1;
+}
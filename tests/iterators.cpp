@@ -0,0 +1,53 @@
+// Walking the ancestors or targets of a node must not allocate, as the walks run on
+// every focus change and geometry pass.
+
+#include <cstdio>
+#include <random>
+
+#include "Hy3Node.hpp"
+#include "alloc_count.hpp"
+#include "fakes.hpp"
+
+static int failures = 0;
+
+static void expectNoAllocations(const char* name, size_t before, size_t visited) {
+	auto allocations = allocationCount() - before;
+
+	if (allocations != 0) {
+		std::fprintf(stderr, "FAIL %s: %zu allocations while visiting %zu nodes\n", name, allocations, visited);
+		failures++;
+	} else if (visited == 0) {
+		std::fprintf(stderr, "FAIL %s: visited no nodes\n", name);
+		failures++;
+	} else {
+		std::printf("ok %s: %zu nodes\n", name, visited);
+	}
+}
+
+int main() {
+	Hy3FakeHost host;
+	std::mt19937_64 rng(1);
+	generateTree(host, rng, 512, 8);
+
+	auto* deepest = host.focusedNode();
+	for (auto& target: host.root->targets()) {
+		if (nodeDepth(target) > nodeDepth(*deepest)) deepest = &target;
+	}
+
+	size_t visited = 0;
+	auto before = allocationCount();
+	for (auto& target: host.root->targets()) visited += target.is_target();
+	expectNoAllocations("targets", before, visited);
+
+	visited = 0;
+	before = allocationCount();
+	for (auto& target: host.root->targets(true)) visited += target.is_target();
+	expectNoAllocations("visible targets", before, visited);
+
+	visited = 0;
+	before = allocationCount();
+	for (auto& ancestor: deepest->ancestors()) visited += ancestor.parent != nullptr;
+	expectNoAllocations("ancestors", before, visited);
+
+	return failures == 0 ? 0 : 1;
+}
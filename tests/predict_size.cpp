@@ -0,0 +1,95 @@
+// The size predicted for a new target must match the size the geometry pass gives it
+// once inserted. Predicting runs any scheduled geometry pass first, as the prediction
+// reads the boxes of the last pass.
+
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "Hy3Tree.hpp"
+#include "fakes.hpp"
+
+static int failures = 0;
+
+static void fail(const char* name, uint64_t seed, size_t step, const char* what) {
+	std::fprintf(stderr, "FAIL %s: seed %llu step %zu: %s\n", name, (unsigned long long) seed, step, what);
+	failures++;
+}
+
+// Insert targets into random trees, checking every prediction against the inserted target.
+static void checkPredictions(const char* name, uint64_t seed, Hy3GroupLayout first_layout, bool autotile) {
+	Hy3FakeHost host;
+	host.first_layout = first_layout;
+	host.autotile = {.enable = autotile, .trigger_width = 400, .trigger_height = 300};
+
+	static constexpr Hy3GroupLayout layouts[] = {
+	    Hy3GroupLayout::SplitH,
+	    Hy3GroupLayout::SplitV,
+	    Hy3GroupLayout::Tabbed,
+	};
+
+	std::mt19937_64 rng(seed);
+	std::vector<Hy3FakeTarget*> targets;
+	size_t predicted = 0;
+
+	for (size_t step = 0; step < 64; step++) {
+		// focus and regroup a random target, leaving a pass scheduled for the prediction
+		if (step > 0) {
+			auto& focus = *targets[rng() % targets.size()];
+			focus.markFocused();
+
+			if (rng() % 3 == 0 && nodeDepth(focus) < 6) {
+				makeGroupOn(focus, layouts[rng() % std::size(layouts)], GroupEphemeralityOption::Standard);
+			}
+
+			host.recalcGeometry();
+		}
+
+		auto passes = host.geometry_passes;
+		auto size = host.predictSize();
+
+		if (step > 0 && (host.geometry_pending || host.geometry_passes != passes + 1)) {
+			fail(name, seed, step, "predicting did not run the scheduled geometry pass");
+		}
+
+		auto& target = host.insert(step + 1);
+		targets.push_back(&target);
+		host.flushGeometry();
+
+		// nothing is expanded, so only targets squeezed to nothing have no prediction
+		if (!size) {
+			if (target.visual.w > 0 && target.visual.h > 0) fail(name, seed, step, "no size was predicted");
+			continue;
+		}
+
+		predicted++;
+
+		if (std::abs(target.visual.w - size->w) > 0.01 || std::abs(target.visual.h - size->h) > 0.01) {
+			std::fprintf(
+			    stderr,
+			    "  predicted %.2fx%.2f, got %.2fx%.2f\n",
+			    size->w,
+			    size->h,
+			    target.visual.w,
+			    target.visual.h
+			);
+			fail(name, seed, step, "prediction does not match the inserted target");
+		}
+	}
+
+	if (predicted == 0) fail(name, seed, 0, "no size was ever predicted");
+	else std::printf("ok %s: seed %llu, %zu predictions\n", name, (unsigned long long) seed, predicted);
+}
+
+int main() {
+	for (uint64_t seed = 1; seed <= 4; seed++) {
+		checkPredictions("splith", seed, Hy3GroupLayout::SplitH, false);
+		checkPredictions("splitv", seed, Hy3GroupLayout::SplitV, false);
+		checkPredictions("tabbed", seed, Hy3GroupLayout::Tabbed, false);
+		checkPredictions("autotile", seed, Hy3GroupLayout::SplitH, true);
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#include "alloc_count.hpp"
+
+#include <cstdlib>
+#include <new>
+
+static size_t allocations = 0;
+
+size_t allocationCount() { return allocations; }
+
+// The array and nothrow forms call these by default.
+
+void* operator new(size_t size) {
+	allocations++;
+	if (auto* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
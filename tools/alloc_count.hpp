@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap allocation counting for the tools. Linking alloc_count.cpp replaces the global
+// operator new, so every allocation is counted, including those of standard containers
+// and strings that Hy3NodePool::totalAllocations does not see.
+
+// number of calls to the global operator new since startup
+size_t allocationCount();
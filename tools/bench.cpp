@@ -0,0 +1,339 @@
+// hy3-bench: layout operations on trees of fake targets.
+//
+//   hy3-bench [--iterations N] [--seed N] [benchmark or shape...]
+//
+// Runs every benchmark on every tree shape, or on those named. Prints a JSON object keyed
+// by shape, then by benchmark name, with the mean, p50, p99 and max time per operation
+// and the allocations per operation. Percentiles are the upper bounds of the power of two
+// buckets hy3:debugperf uses. Allocations are counted twice: every call to the global
+// operator new, and the node allocations that hy3:debugperf reports.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Hy3Node.hpp"
+#include "Hy3Tree.hpp"
+#include "NodePool.hpp"
+#include "alloc_count.hpp"
+#include "fakes.hpp"
+#include "perf.hpp"
+
+struct BenchOptions {
+	size_t iterations = 2000;
+	uint64_t seed = 1;
+};
+
+struct BenchContext {
+	Hy3FakeHost& host;
+	std::mt19937_64& rng;
+	std::vector<Hy3FakeTarget*> targets;
+	// every node of the tree, in depth first order
+	std::vector<Hy3Node*> nodes;
+
+	Hy3FakeTarget& randomTarget() { return *this->targets[this->rng() % this->targets.size()]; }
+	ShiftDirection randomDirection() { return static_cast<ShiftDirection>(this->rng() % 4); }
+
+	// An iteration is timed as a whole, unless the benchmark calls startTimer and stopTimer
+	// around the part to measure, keeping its setup and cleanup out.
+	void startTimer() {
+		this->stopped = false;
+		this->allocations = allocationCount();
+		this->node_allocations = Hy3NodePool::totalAllocations();
+		this->start = std::chrono::steady_clock::now();
+	}
+
+	void stopTimer() {
+		if (this->stopped) return;
+		auto elapsed = std::chrono::steady_clock::now() - this->start;
+		this->ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		this->allocations = allocationCount() - this->allocations;
+		this->node_allocations = Hy3NodePool::totalAllocations() - this->node_allocations;
+		this->stopped = true;
+	}
+
+	std::chrono::steady_clock::time_point start;
+	bool stopped = false;
+	// measured by stopTimer
+	uint64_t ns = 0;
+	size_t allocations = 0;
+	size_t node_allocations = 0;
+};
+
+struct BenchShape {
+	const char* name;
+	std::function<void(Hy3FakeHost&, std::mt19937_64&)> build;
+};
+
+static const BenchShape shapes[] = {
+    {"deep", [](Hy3FakeHost& host, std::mt19937_64&) { buildDeepTree(host, 32); }},
+    {"wide", [](Hy3FakeHost& host, std::mt19937_64&) { buildWideTree(host, 64, 4); }},
+    {"tabs_500", [](Hy3FakeHost& host, std::mt19937_64&) { buildTabGroup(host, 500); }},
+    {"workspace_1000", [](Hy3FakeHost& host, std::mt19937_64& rng) { generateTree(host, rng, 1000); }},
+};
+
+struct Benchmark {
+	const char* name;
+	std::function<void(BenchContext&)> op;
+};
+
+static const Benchmark benchmarks[] = {
+    {"insert_remove",
+     [](BenchContext& ctx) {
+	     auto id = ctx.targets.size() + 1;
+	     ctx.host.remove(ctx.host.insert(id));
+	     ctx.host.flushGeometry();
+     }},
+    {"geometry_pass_full",
+     [](BenchContext& ctx) {
+	     ctx.host.root->markDirtyRecursive();
+	     ctx.host.recalcGeometry();
+	     ctx.host.flushGeometry();
+     }},
+    {"geometry_pass_one",
+     [](BenchContext& ctx) {
+	     ctx.randomTarget().markDirty();
+	     ctx.host.recalcGeometry();
+	     ctx.host.flushGeometry();
+     }},
+    {"focus_direction",
+     [](BenchContext& ctx) {
+	     auto* focused = ctx.host.focusedNode();
+	     auto result = shiftOrGetFocus(
+	         *focused,
+	         ctx.randomDirection(),
+	         false,
+	         false,
+	         false,
+	         CollapsePolicy::EmptySplits
+	     );
+
+	     if (result.focus != nullptr) result.focus->markFocused();
+	     ctx.host.flushGeometry();
+     }},
+    {"shift_direction",
+     [](BenchContext& ctx) {
+	     auto& target = ctx.randomTarget();
+	     target.markFocused();
+	     auto result =
+	         shiftOrGetFocus(target, ctx.randomDirection(), true, false, false, CollapsePolicy::EmptySplits);
+
+	     if (result.shifted) target.markFocused();
+	     ctx.host.flushGeometry();
+     }},
+    {"focused_node",
+     [](BenchContext& ctx) {
+	     auto* focused = ctx.host.focusedNode();
+	     if (focused == nullptr) std::abort();
+     }},
+    // see Hy3Layout::getNodeFromWindow
+    {"target_lookup",
+     [](BenchContext& ctx) {
+	     auto id = ctx.randomTarget().target_id;
+	     if (ctx.host.find(id) == nullptr) std::abort();
+     }},
+    {"debug_node",
+     [](BenchContext& ctx) {
+	     auto debug = ctx.host.root->debugNode();
+	     if (debug.empty()) std::abort();
+     }},
+    // Extract a target inserted next to a random one, leaving the tree as it was.
+    {"extract_and_merge",
+     [](BenchContext& ctx) {
+	     ctx.randomTarget().markFocused();
+	     auto& target = ctx.host.insert(ctx.targets.size() + 1);
+
+	     ctx.startTimer();
+	     auto extracted = target.parent->extractAndMerge(target, nullptr, CollapsePolicy::InvalidOnly);
+	     ctx.stopTimer();
+
+	     extracted.reset();
+	     ctx.host.flushGeometry();
+     }},
+    // Collapse a split wrapped in a split of the same layout, leaving the tree as it was.
+    {"collapse_parents",
+     [](BenchContext& ctx) {
+	     auto& target = ctx.randomTarget();
+	     target.wrap(Hy3GroupLayout::SplitH, GroupEphemeralityOption::Standard, false);
+	     target.wrap(Hy3GroupLayout::SplitH, GroupEphemeralityOption::Standard, false);
+
+	     ctx.startTimer();
+	     target.parent->collapseParents(CollapsePolicy::InvalidOnly);
+	     ctx.stopTimer();
+
+	     target.parent->collapseParents(CollapsePolicy::SingleNodeGroups);
+	     ctx.host.flushGeometry();
+     }},
+    {"walk_targets",
+     [](BenchContext& ctx) {
+	     size_t count = 0;
+	     for (auto& target: ctx.host.root->targets()) count += target.hidden ? 0 : 1;
+	     if (count > ctx.targets.size()) std::abort();
+     }},
+    {"walk_ancestors",
+     [](BenchContext& ctx) {
+	     size_t depth = 0;
+	     for (auto& ancestor: ctx.randomTarget().ancestors()) depth += ancestor.hidden ? 0 : 1;
+	     if (depth > ctx.targets.size()) std::abort();
+     }},
+    // Type checks and downcasts of every node in the tree, with RTTI and with the node
+    // type tag Hy3Node uses instead.
+    {"cast_dynamic",
+     [](BenchContext& ctx) {
+	     size_t children = 0;
+	     for (auto* node: ctx.nodes) {
+		     if (auto* group = dynamic_cast<Hy3GroupNode*>(node)) children += group->children.size();
+		     else if (dynamic_cast<Hy3TargetNode*>(node) == nullptr) std::abort();
+	     }
+
+	     if (children != ctx.nodes.size() - 1) std::abort();
+     }},
+    {"cast_tag",
+     [](BenchContext& ctx) {
+	     size_t children = 0;
+	     for (auto* node: ctx.nodes) {
+		     if (node->is_group()) children += node->as_group().children.size();
+		     else if (!node->is_target()) std::abort();
+	     }
+
+	     if (children != ctx.nodes.size() - 1) std::abort();
+     }},
+};
+
+static void collectNodes(Hy3Node& node, std::vector<Hy3Node*>& nodes) {
+	nodes.push_back(&node);
+	if (!node.is_group()) return;
+
+	for (auto& child: node.as_group().children) {
+		collectNodes(*child, nodes);
+	}
+}
+
+static std::string runBenchmark(
+    const Benchmark& bench,
+    const BenchShape& shape,
+    const BenchOptions& options
+) {
+	Hy3FakeHost host;
+	std::mt19937_64 rng(options.seed);
+	shape.build(host, rng);
+
+	BenchContext ctx {.host = host, .rng = rng, .targets = {}, .nodes = {}};
+	for (auto& target: host.root->targets()) {
+		ctx.targets.push_back(&static_cast<Hy3FakeTarget&>(target));
+	}
+
+	collectNodes(*host.root, ctx.nodes);
+
+	Hy3PerfCounter counter;
+	size_t allocations = 0;
+
+	for (size_t i = 0; i < options.iterations; i++) {
+		ctx.startTimer();
+		bench.op(ctx);
+		ctx.stopTimer();
+
+		counter.record(ctx.ns, ctx.node_allocations);
+		allocations += ctx.allocations;
+	}
+
+	auto ops = static_cast<double>(counter.count);
+
+	return std::format(
+	    "\"{}\":{{\"ns_per_op\":{:.1f},\"p50_ns\":{},\"p99_ns\":{},\"max_ns\":{},"
+	    "\"allocs_per_op\":{:.2f},\"node_allocs_per_op\":{:.2f}}}",
+	    bench.name,
+	    counter.total_ns / ops,
+	    counter.percentile(0.5),
+	    counter.percentile(0.99),
+	    counter.max_ns,
+	    allocations / ops,
+	    counter.allocations / ops
+	);
+}
+
+static bool parseCount(const char* arg, uint64_t& out) {
+	char* end = nullptr;
+	out = std::strtoull(arg, &end, 10);
+	return end != arg && *end == '\0';
+}
+
+template <typename T, size_t N>
+static bool hasName(const T (&entries)[N], std::string_view name) {
+	return std::any_of(std::begin(entries), std::end(entries), [&](auto& entry) {
+		return name == entry.name;
+	});
+}
+
+static bool isSelected(const std::vector<std::string_view>& selected, std::string_view name) {
+	return std::find(selected.begin(), selected.end(), name) != selected.end();
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	std::vector<std::string_view> selected_benchmarks;
+	std::vector<std::string_view> selected_shapes;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		uint64_t value = 0;
+
+		if (arg.starts_with("--") && i + 1 < argc && parseCount(argv[i + 1], value)) {
+			if (arg == "--iterations") options.iterations = value;
+			else if (arg == "--seed") options.seed = value;
+			else {
+				std::fprintf(stderr, "unknown option %s\n", argv[i]);
+				return 2;
+			}
+
+			i++;
+		} else if (arg.starts_with("--")) {
+			std::fprintf(stderr, "option %s needs a numeric argument\n", argv[i]);
+			return 2;
+		} else if (hasName(shapes, arg)) {
+			selected_shapes.push_back(arg);
+		} else if (hasName(benchmarks, arg)) {
+			selected_benchmarks.push_back(arg);
+		} else {
+			std::fprintf(stderr, "unknown benchmark or shape %s\n", argv[i]);
+			return 2;
+		}
+	}
+
+	if (options.iterations == 0) {
+		std::fprintf(stderr, "--iterations must be positive\n");
+		return 2;
+	}
+
+	std::string json = "{";
+
+	for (auto& shape: shapes) {
+		if (!selected_shapes.empty() && !isSelected(selected_shapes, shape.name)) continue;
+
+		if (json.size() > 1) json += ",";
+		json += std::format("\"{}\":{{", shape.name);
+		auto first = true;
+
+		for (auto& bench: benchmarks) {
+			if (!selected_benchmarks.empty() && !isSelected(selected_benchmarks, bench.name)) continue;
+
+			if (!first) json += ",";
+			json += runBenchmark(bench, shape, options);
+			first = false;
+		}
+
+		json += "}";
+	}
+
+	std::printf("%s}\n", json.c_str());
+	return 0;
+}
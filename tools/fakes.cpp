@@ -0,0 +1,212 @@
+#include "fakes.hpp"
+
+#include <format>
+#include <stdexcept>
+#include <vector>
+
+std::unique_ptr<Hy3Node> Hy3FakeTarget::create(Hy3NodePool& pool, uint64_t target_id) {
+	auto* node = new (pool) Hy3FakeTarget();
+	node->target_id = target_id;
+	node->name = std::format("target {}", target_id);
+	return std::unique_ptr<Hy3Node>(node);
+}
+
+void Hy3FakeTarget::applyGeometry(const Hy3Box& logical, const Hy3Box& visual, bool hidden, bool warp) {
+	this->logical = logical;
+	this->visual = visual;
+	this->is_hidden = hidden;
+	this->applies++;
+}
+
+std::string Hy3FakeTarget::describe() { return std::format("fake {}", this->target_id); }
+
+Hy3FakeHost::Hy3FakeHost(Hy3Box area): area(area), pool(Hy3NodePool::create()) {
+	this->root.reset(
+	    static_cast<Hy3GroupNode*>(Hy3GroupNode::create(*this->pool, Hy3GroupLayout::Root).release())
+	);
+	this->root->tree_host = this;
+}
+
+Hy3FakeHost::~Hy3FakeHost() {
+	this->root.reset();
+	this->pool->release();
+}
+
+void Hy3FakeHost::onAttached(Hy3Node& node) {
+	if (node.is_group()) {
+		for (auto& child: node.as_group().children) {
+			this->onAttached(*child);
+		}
+
+		return;
+	}
+
+	auto& target = static_cast<Hy3FakeTarget&>(node.as_target_node());
+	this->targets[target.target_id] = &target;
+}
+
+void Hy3FakeHost::onDetached(Hy3Node& node) {
+	if (node.is_group()) {
+		for (auto& child: node.as_group().children) {
+			this->onDetached(*child);
+		}
+
+		return;
+	}
+
+	auto& target = static_cast<Hy3FakeTarget&>(node.as_target_node());
+	auto it = this->targets.find(target.target_id);
+	if (it != this->targets.end() && it->second == &target) this->targets.erase(it);
+}
+
+void Hy3FakeHost::recalcGeometry(bool no_animation) {
+	if (this->geometry_pending) this->geometry_stats.coalesced++;
+	this->geometry_pending = true;
+}
+
+void Hy3FakeHost::flushGeometry() {
+	if (!this->geometry_pending) return;
+	this->geometry_pending = false;
+	this->geometry_passes++;
+
+	this->root->visualBox = this->area;
+	this->last_pass_nodes = this->root->recalcSizePosRecursive(this->offsets, this->params, true);
+}
+
+Hy3FakeTarget& Hy3FakeHost::insert(uint64_t target_id, std::optional<Hy3Point> focal_point) {
+	// placement and autotiling read node sizes
+	this->flushGeometry();
+
+	auto* at_point = focal_point ? this->nodeAt(*focal_point) : nullptr;
+	auto plan = planInsert(*this->root, at_point, focal_point, this->autotile);
+	auto* node = insertPlanned(
+	    *this->root,
+	    Hy3FakeTarget::create(*this->pool, target_id),
+	    plan,
+	    this->first_layout
+	);
+
+	if (node == nullptr) throw std::runtime_error(std::format("failed to insert target {}", target_id));
+	return static_cast<Hy3FakeTarget&>(node->as_target_node());
+}
+
+std::optional<Hy3Size> Hy3FakeHost::predictSize() {
+	this->flushGeometry();
+
+	auto plan = planInsert(*this->root, nullptr, std::nullopt, this->autotile);
+	return predictInsertSize(plan, this->area, this->first_layout, this->params);
+}
+
+void Hy3FakeHost::remove(Hy3FakeTarget& target) {
+	target.parent->extractAndMerge(target, nullptr, CollapsePolicy::InvalidOnly);
+	this->recalcGeometry();
+}
+
+void Hy3FakeHost::checkInvariants(std::vector<std::string>& errors, bool dirty_only) {
+	std::vector<Hy3TargetNode*> checked;
+	this->root->checkInvariants(errors, checked, dirty_only);
+
+	for (auto* node: checked) {
+		auto& target = static_cast<Hy3FakeTarget&>(*node);
+		if (this->find(target.target_id) != &target)
+			errors.push_back(std::format("target {} is not indexed by its host", target.target_id));
+	}
+
+	auto target_count = dirty_only ? this->root->windowCount() : checked.size();
+	if (target_count != this->targets.size())
+		errors.push_back(
+		    std::format("tree has {} targets but {} are indexed", target_count, this->targets.size())
+		);
+}
+
+Hy3FakeTarget* Hy3FakeHost::find(uint64_t target_id) {
+	auto it = this->targets.find(target_id);
+	return it == this->targets.end() ? nullptr : it->second;
+}
+
+Hy3Node* Hy3FakeHost::nodeAt(Hy3Point point) {
+	for (auto& target: this->root->targets(true)) {
+		auto& box = target.visualBox;
+		if (point.x >= box.x && point.x < box.x + box.w && point.y >= box.y && point.y < box.y + box.h)
+			return &target;
+	}
+
+	return nullptr;
+}
+
+Hy3Node* Hy3FakeHost::focusedNode() {
+	if (this->root->children.empty()) return nullptr;
+	return &this->root->children.front()->getFocusedNode();
+}
+
+size_t nodeDepth(Hy3Node& node) {
+	size_t depth = 0;
+	for (auto* n = node.parent; n != nullptr; n = n->parent) depth++;
+	return depth;
+}
+
+void generateTree(
+    Hy3FakeHost& host,
+    std::mt19937_64& rng,
+    size_t target_count,
+    size_t max_depth,
+    double wrap_chance
+) {
+	static constexpr Hy3GroupLayout layouts[] = {
+	    Hy3GroupLayout::SplitH,
+	    Hy3GroupLayout::SplitV,
+	    Hy3GroupLayout::Tabbed,
+	};
+
+	std::vector<Hy3FakeTarget*> inserted;
+	inserted.reserve(target_count);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+	for (size_t i = 0; i < target_count; i++) {
+		if (!inserted.empty()) {
+			auto* next_to = inserted[rng() % inserted.size()];
+			next_to->markFocused();
+
+			if (chance(rng) < wrap_chance && nodeDepth(*next_to) < max_depth) {
+				makeGroupOn(*next_to, layouts[rng() % std::size(layouts)], GroupEphemeralityOption::Standard);
+			}
+		}
+
+		inserted.push_back(&host.insert(host.targetCount() + 1));
+	}
+
+	host.flushGeometry();
+}
+
+void buildDeepTree(Hy3FakeHost& host, size_t depth) {
+	host.first_layout = Hy3GroupLayout::SplitH;
+
+	for (size_t i = 0; i < depth; i++) {
+		auto& target = host.insert(i + 1);
+		if (i > 0 && i + 1 < depth) makeOppositeGroupOn(target, GroupEphemeralityOption::Standard);
+	}
+
+	host.flushGeometry();
+}
+
+void buildWideTree(Hy3FakeHost& host, size_t columns, size_t rows) {
+	host.first_layout = Hy3GroupLayout::SplitH;
+
+	std::vector<Hy3FakeTarget*> tops;
+	tops.reserve(columns);
+	for (size_t i = 0; i < columns; i++) tops.push_back(&host.insert(i + 1));
+
+	for (auto* top: tops) {
+		makeGroupOn(*top, Hy3GroupLayout::SplitV, GroupEphemeralityOption::Standard);
+		top->markFocused();
+		for (size_t i = 1; i < rows; i++) host.insert(host.targetCount() + 1);
+	}
+
+	host.flushGeometry();
+}
+
+void buildTabGroup(Hy3FakeHost& host, size_t target_count) {
+	host.first_layout = Hy3GroupLayout::Tabbed;
+	for (size_t i = 0; i < target_count; i++) host.insert(i + 1);
+	host.flushGeometry();
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Hy3Node.hpp"
+#include "Hy3Tree.hpp"
+#include "geometry.hpp"
+
+// Fake targets and a fake layout for driving hy3core outside of a compositor. Shared by
+// hy3-bench, hy3-replay, hy3-fuzz and the tests.
+
+struct Hy3FakeTarget : Hy3TargetNode {
+	// chosen by the caller, for example the window id of a recording
+	uint64_t target_id = 0;
+	std::string name;
+	bool is_urgent = false;
+
+	// last geometry pushed by the geometry pass
+	Hy3Box logical;
+	Hy3Box visual;
+	bool is_hidden = false;
+	size_t applies = 0;
+
+	static std::unique_ptr<Hy3Node> create(Hy3NodePool& pool, uint64_t target_id);
+
+	bool alive() override { return true; }
+	std::string title() override { return this->name; }
+	bool urgent() override { return this->is_urgent; }
+	void applyGeometry(const Hy3Box& logical, const Hy3Box& visual, bool hidden, bool warp) override;
+	void warpGeometry() override {}
+	std::string describe() override;
+};
+
+// Owns a tree of fake targets like Hy3Layout owns the tree of a workspace. Geometry
+// passes are scheduled by recalcGeometry and run by flushGeometry, which the caller
+// invokes where hyprland would render a frame.
+class Hy3FakeHost : public Hy3TreeHost {
+public:
+	explicit Hy3FakeHost(Hy3Box area = {0, 0, 1920, 1080});
+	~Hy3FakeHost() override;
+
+	Hy3FakeHost(const Hy3FakeHost&) = delete;
+	Hy3FakeHost& operator=(const Hy3FakeHost&) = delete;
+
+	Hy3NodePool& nodePool() override { return *this->pool; }
+	void onAttached(Hy3Node&) override;
+	void onDetached(Hy3Node&) override;
+	void recalcGeometry(bool no_animation = false) override;
+	void flushGeometry() override;
+	std::string describe() override { return "fake"; }
+
+	// Insert a new target next to the focused node, or the node under `focal_point`,
+	// and focus it. See Hy3Layout::insertNode.
+	Hy3FakeTarget& insert(uint64_t target_id, std::optional<Hy3Point> focal_point = std::nullopt);
+	// Size insert() would give a new target without a focal point. Runs a scheduled geometry
+	// pass first. See Hy3Layout::predictSizeForNewTarget.
+	std::optional<Hy3Size> predictSize();
+	// Remove a target from the tree. See Hy3Layout::removeTarget.
+	void remove(Hy3FakeTarget& target);
+
+	// Append every broken tree or index invariant to `errors`. See Hy3Layout::checkInvariants.
+	void checkInvariants(std::vector<std::string>& errors, bool dirty_only = false);
+
+	Hy3FakeTarget* find(uint64_t target_id);
+	Hy3Node* nodeAt(Hy3Point point);
+	Hy3Node* focusedNode();
+	size_t targetCount() const { return this->targets.size(); }
+
+	std::unique_ptr<Hy3GroupNode> root;
+	Hy3Box area;
+	// distance from the area to the monitor edges, see Hy3Layout::recalcGeometryNow
+	Hy3Box offsets;
+	Hy3GeometryParams params {
+	    .gaps_in = {5, 5, 5, 5},
+	    .group_inset = 10,
+	    .tab_offset = 27,
+	};
+	Hy3AutotileParams autotile;
+	Hy3GroupLayout first_layout = Hy3GroupLayout::SplitH;
+
+	bool geometry_pending = false;
+	size_t geometry_passes = 0;
+	// nodes recalculated by the last geometry pass
+	size_t last_pass_nodes = 0;
+
+private:
+	Hy3NodePool* pool;
+	std::unordered_map<uint64_t, Hy3FakeTarget*> targets;
+};
+
+// Build a random tree of `target_count` targets in an empty host. Each target is inserted
+// next to a random existing target, which is first wrapped in a group of a random layout
+// with probability `wrap_chance` while the tree is shallower than `max_depth`.
+void generateTree(
+    Hy3FakeHost& host,
+    std::mt19937_64& rng,
+    size_t target_count,
+    size_t max_depth = 6,
+    double wrap_chance = 0.3
+);
+
+// Build a spiral of `depth` targets in an empty host: every target but the first and last
+// is wrapped in a split opposite to its parent's, which holds the next target.
+void buildDeepTree(Hy3FakeHost& host, size_t depth);
+// Build a split of `columns` splits of `rows` targets each in an empty host.
+void buildWideTree(Hy3FakeHost& host, size_t columns, size_t rows);
+// Build a single tab group of `target_count` targets in an empty host.
+void buildTabGroup(Hy3FakeHost& host, size_t target_count);
+
+// Depth of the node below the root node, where the first group has depth 1.
+size_t nodeDepth(Hy3Node& node);
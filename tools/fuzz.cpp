@@ -0,0 +1,328 @@
+// hy3-fuzz: random tree operations on fake targets, with the tree invariants checked
+// after every step.
+//
+//   hy3-fuzz [--seed N] [--runs N] [--steps N] [--targets N]
+//
+// Run i uses seed + i, starting from a tree of --targets generated targets. Each step
+// inserts, removes, moves, focuses, wraps, regroups, resizes, expands, equalizes or
+// collapses a random node, then runs the geometry pass. The nodes the pass recalculates
+// are checked before it like debug:check_invariants does, and the whole tree after it.
+// Explicit collapses are also checked to leave no collapsible group above. The first failing
+// run is printed with the command reproducing it. Prints the slowest step of each
+// operation as JSON.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Hy3Node.hpp"
+#include "Hy3Tree.hpp"
+#include "fakes.hpp"
+#include "log.hpp"
+
+enum class FuzzOp {
+	Insert,
+	Remove,
+	Shift,
+	Focus,
+	Wrap,
+	SetLayout,
+	Resize,
+	Collapse,
+	Expand,
+	Equalize,
+	Count,
+};
+
+static const char* opName(FuzzOp op) {
+	switch (op) {
+	case FuzzOp::Insert: return "insert";
+	case FuzzOp::Remove: return "remove";
+	case FuzzOp::Shift: return "shift";
+	case FuzzOp::Focus: return "focus";
+	case FuzzOp::Wrap: return "wrap";
+	case FuzzOp::SetLayout: return "set_layout";
+	case FuzzOp::Resize: return "resize";
+	case FuzzOp::Collapse: return "collapse";
+	case FuzzOp::Expand: return "expand";
+	case FuzzOp::Equalize: return "equalize";
+	case FuzzOp::Count: break;
+	}
+
+	return "unknown";
+}
+
+struct FuzzOptions {
+	uint64_t seed = 1;
+	size_t runs = 100;
+	size_t steps = 1000;
+	size_t targets = 8;
+};
+
+struct WorstStep {
+	uint64_t ns = 0;
+	uint64_t seed = 0;
+	size_t step = 0;
+};
+
+static std::vector<WorstStep> worst(static_cast<size_t>(FuzzOp::Count));
+
+static void logToStderr(Hy3LogLevel level, const std::string& message) {
+	if (level >= Hy3LogLevel::Warn) std::fprintf(stderr, "[hy3] %s\n", message.c_str());
+}
+
+static Hy3GroupLayout randomLayout(std::mt19937_64& rng) {
+	static constexpr Hy3GroupLayout layouts[] = {
+	    Hy3GroupLayout::SplitH,
+	    Hy3GroupLayout::SplitV,
+	    Hy3GroupLayout::Tabbed,
+	};
+
+	return layouts[rng() % std::size(layouts)];
+}
+
+static void collectNodes(Hy3Node& node, std::vector<Hy3Node*>& nodes) {
+	if (!node.is_root()) nodes.push_back(&node);
+	if (!node.is_group()) return;
+
+	for (auto& child: node.as_group().children) {
+		collectNodes(*child, nodes);
+	}
+}
+
+// Apply one random operation, returns a description of it for the failure report.
+// Invariants specific to the operation are appended to `errors`.
+static std::string step(
+    Hy3FakeHost& host,
+    std::mt19937_64& rng,
+    FuzzOp op,
+    uint64_t& next_id,
+    std::vector<std::string>& errors
+) {
+	std::vector<Hy3Node*> nodes;
+	collectNodes(*host.root, nodes);
+
+	std::vector<Hy3FakeTarget*> targets;
+	for (auto& target: host.root->targets()) targets.push_back(&static_cast<Hy3FakeTarget&>(target));
+
+	// operations on existing nodes need a tree
+	if (targets.empty()) op = FuzzOp::Insert;
+
+	auto* node = nodes.empty() ? nullptr : nodes[rng() % nodes.size()];
+	auto* target = targets.empty() ? nullptr : targets[rng() % targets.size()];
+	auto direction = static_cast<ShiftDirection>(rng() % 4);
+	auto direction_char = getShiftDirectionChar(direction);
+
+	switch (op) {
+	case FuzzOp::Insert: {
+		auto id = next_id++;
+
+		if (rng() % 4 == 0) {
+			Hy3Point point {
+			    host.area.x + static_cast<double>(rng() % 1000) / 1000 * host.area.w,
+			    host.area.y + static_cast<double>(rng() % 1000) / 1000 * host.area.h,
+			};
+
+			host.insert(id, point);
+			return std::format("insert {} at {},{}", id, point.x, point.y);
+		}
+
+		if (target != nullptr) target->markFocused();
+		host.insert(id);
+		return std::format("insert {} next to {}", id, target ? target->target_id : 0);
+	}
+	case FuzzOp::Remove: {
+		auto id = target->target_id;
+		host.remove(*target);
+		return std::format("remove {}", id);
+	}
+	case FuzzOp::Shift:
+	case FuzzOp::Focus: {
+		auto shift = op == FuzzOp::Shift;
+		auto once = rng() % 2 == 0;
+		auto visible = rng() % 2 == 0;
+
+		target->markFocused();
+		auto result = shiftOrGetFocus(*target, direction, shift, once, visible, CollapsePolicy::EmptySplits);
+		if (result.shifted) target->markFocused();
+		else if (result.focus != nullptr) result.focus->markFocused();
+
+		return std::format(
+		    "{} {} {}{}{}",
+		    shift ? "shift" : "focus",
+		    target->target_id,
+		    direction_char,
+		    once ? " once" : "",
+		    visible ? " visible" : ""
+		);
+	}
+	case FuzzOp::Wrap: {
+		auto layout = randomLayout(rng);
+		auto ephemeral = rng() % 2 == 0 ? GroupEphemeralityOption::Standard : GroupEphemeralityOption::Ephemeral;
+		auto description = std::format(
+		    "wrap node {} in layout {} ephemeral {}",
+		    node->id,
+		    static_cast<int>(layout),
+		    static_cast<int>(ephemeral)
+		);
+
+		makeGroupOn(*node, layout, ephemeral);
+		return description;
+	}
+	case FuzzOp::SetLayout: {
+		auto layout = randomLayout(rng);
+		auto& group = node->parent->is_root() ? node->as_group() : node->parent->as_group();
+		if (!group.is_root()) group.setLayout(layout);
+		host.recalcGeometry();
+		return std::format("set layout of group {} to {}", group.id, static_cast<int>(layout));
+	}
+	case FuzzOp::Resize: {
+		auto delta = static_cast<double>(rng() % 400) - 200;
+		host.flushGeometry();
+		node->resize(direction, delta);
+		return std::format("resize node {} {} by {}", node->id, direction_char, delta);
+	}
+	case FuzzOp::Collapse: {
+		auto policy = static_cast<CollapsePolicy>(rng() % 3);
+		auto* group = node->is_group() ? node : node->parent;
+		auto id = group->id;
+		if (auto* kept = group->collapseParents(policy)) kept->checkCollapsed(errors);
+		host.recalcGeometry();
+		return std::format("collapse parents of {} with policy {}", id, static_cast<int>(policy));
+	}
+	case FuzzOp::Expand: {
+		static constexpr ExpandOption options[] = {
+		    ExpandOption::Expand,
+		    ExpandOption::Shrink,
+		    ExpandOption::Base,
+		};
+
+		// like hy3:expand, on the focused node, raised to a group sometimes
+		auto option = options[rng() % std::size(options)];
+		target->markFocused();
+		if (rng() % 3 == 0 && !target->parent->is_root()) target->parent->markFocused();
+
+		// children of the root are only expanded to go fullscreen, which is left to the host
+		auto& focused = host.root->getFocusedNode(false, true);
+		if (focused.is_root() || focused.parent->is_root()) return "expand root";
+		expandNode(focused, option);
+		return std::format("expand node {} with option {}", focused.id, static_cast<int>(option));
+	}
+	case FuzzOp::Equalize: {
+		auto recursive = rng() % 2 == 0;
+		auto& group = recursive ? *host.root : *node->parent;
+		equalizeNode(group, recursive);
+		return std::format("equalize node {}{}", group.id, recursive ? " recursive" : "");
+	}
+	case FuzzOp::Count: break;
+	}
+
+	return "none";
+}
+
+// Run one seed, returns false and prints the failure if any invariant broke.
+static bool run(const FuzzOptions& options, uint64_t seed) {
+	Hy3FakeHost host;
+	std::mt19937_64 rng(seed);
+	generateTree(host, rng, options.targets);
+	uint64_t next_id = options.targets + 1;
+
+	std::vector<std::string> errors;
+	host.checkInvariants(errors);
+	std::string description = "generate tree";
+	size_t i = 0;
+
+	for (; i < options.steps && errors.empty(); i++) {
+		auto op = static_cast<FuzzOp>(rng() % static_cast<size_t>(FuzzOp::Count));
+
+		try {
+			auto start = std::chrono::steady_clock::now();
+			description = step(host, rng, op, next_id, errors);
+			host.checkInvariants(errors, true);
+			host.flushGeometry();
+			auto elapsed = std::chrono::steady_clock::now() - start;
+
+			auto ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+			auto& slowest = worst[static_cast<size_t>(op)];
+			if (ns > slowest.ns) slowest = {.ns = ns, .seed = seed, .step = i};
+		} catch (const std::exception& e) {
+			errors.push_back(std::format("exception: {}", e.what()));
+		}
+
+		if (errors.empty()) host.checkInvariants(errors);
+	}
+
+	if (errors.empty()) return true;
+
+	std::fprintf(stderr, "seed %llu failed at step %zu: %s\n", (unsigned long long) seed, i, description.c_str());
+	for (auto& error: errors) std::fprintf(stderr, "  %s\n", error.c_str());
+	std::fprintf(stderr, "%s\n", host.root->debugNode().c_str());
+	std::fprintf(
+	    stderr,
+	    "reproduce with: hy3-fuzz --seed %llu --runs 1 --steps %zu --targets %zu\n",
+	    (unsigned long long) seed,
+	    i,
+	    options.targets
+	);
+
+	return false;
+}
+
+static bool parseCount(const char* arg, uint64_t& out) {
+	char* end = nullptr;
+	out = std::strtoull(arg, &end, 10);
+	return end != arg && *end == '\0';
+}
+
+int main(int argc, char** argv) {
+	g_logSink = logToStderr;
+	FuzzOptions options;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		uint64_t value = 0;
+
+		if (i + 1 >= argc || !parseCount(argv[i + 1], value)) {
+			std::fprintf(stderr, "usage: hy3-fuzz [--seed N] [--runs N] [--steps N] [--targets N]\n");
+			return 2;
+		}
+
+		if (arg == "--seed") options.seed = value;
+		else if (arg == "--runs") options.runs = value;
+		else if (arg == "--steps") options.steps = value;
+		else if (arg == "--targets") options.targets = value;
+		else {
+			std::fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 2;
+		}
+
+		i++;
+	}
+
+	for (size_t i = 0; i < options.runs; i++) {
+		if (!run(options, options.seed + i)) return 1;
+	}
+
+	std::string json = std::format("{{\"runs\":{},\"steps\":{},\"worst_ns\":{{", options.runs, options.steps);
+
+	for (size_t i = 0; i < worst.size(); i++) {
+		json += std::format(
+		    "{}\"{}\":{{\"ns\":{},\"seed\":{},\"step\":{}}}",
+		    i == 0 ? "" : ",",
+		    opName(static_cast<FuzzOp>(i)),
+		    worst[i].ns,
+		    worst[i].seed,
+		    worst[i].step
+		);
+	}
+
+	std::printf("%s}}\n", json.c_str());
+	return 0;
+}
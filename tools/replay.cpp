@@ -0,0 +1,423 @@
+// hy3-replay: replay a recording made with hy3:record on fake targets.
+//
+//   hy3-replay [--events] <recording>
+//
+// Rebuilds the workspaces from the snapshot at the start of the recording, then replays
+// every event on hy3core and times it, including the geometry pass hyprland would run
+// on the next frame. Prints the latencies per event type as JSON, and with --events the
+// recorded and replayed latency of every event first.
+//
+// Dispatchers are replayed on the focused workspace. Only those that map onto tree
+// operations are supported, the events nested in any other dispatcher call are replayed
+// on their own instead.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <format>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Hy3Node.hpp"
+#include "Hy3Tree.hpp"
+#include "fakes.hpp"
+#include "log.hpp"
+#include "record.hpp"
+
+static void logToStderr(Hy3LogLevel level, const std::string& message) {
+	if (level >= Hy3LogLevel::Warn) std::fprintf(stderr, "[hy3] %s\n", message.c_str());
+}
+
+static std::string_view trim(std::string_view str, std::string_view chars = " \t") {
+	auto start = str.find_first_not_of(chars);
+	if (start == std::string_view::npos) return {};
+	auto end = str.find_last_not_of(chars);
+	return str.substr(start, end - start + 1);
+}
+
+// Rewrite a command of a batch list into the "name, args" form dispatchers are recorded
+// in. Same rules as parseCommand in dispatchers.cpp: the name may have a hy3: prefix and
+// is followed by either a space or a comma.
+static std::string normalizeCommand(std::string_view command) {
+	auto name_end = command.find_first_of(" \t,");
+	auto name = command.substr(0, name_end);
+	if (name.starts_with("hy3:")) name.remove_prefix(4);
+
+	auto args = name_end == std::string_view::npos ? std::string_view() : trim(command.substr(name_end), " \t,");
+	return args.empty() ? std::string(name) : std::format("{}, {}", name, args);
+}
+
+static std::vector<std::string_view> splitArgs(std::string_view args) {
+	std::vector<std::string_view> out;
+
+	while (!args.empty()) {
+		auto end = args.find(',');
+		out.push_back(trim(args.substr(0, end)));
+		if (end == std::string_view::npos) break;
+		args.remove_prefix(end + 1);
+	}
+
+	return out;
+}
+
+static bool hasArg(const std::vector<std::string_view>& args, std::string_view arg) {
+	for (size_t i = 1; i < args.size(); i++) {
+		if (args[i] == arg) return true;
+	}
+
+	return false;
+}
+
+static std::optional<ShiftDirection> parseDirection(std::string_view arg) {
+	if (arg.empty()) return std::nullopt;
+
+	switch (arg.front()) {
+	case 'l': return ShiftDirection::Left;
+	case 'r': return ShiftDirection::Right;
+	case 'u': return ShiftDirection::Up;
+	case 'd': return ShiftDirection::Down;
+	default: return std::nullopt;
+	}
+}
+
+static std::unique_ptr<Hy3Node> restoreNode(Hy3FakeHost& host, const Hy3RecordNode& record) {
+	std::unique_ptr<Hy3Node> node;
+
+	if (!record.group) {
+		node = Hy3FakeTarget::create(host.nodePool(), record.window);
+	} else {
+		node = host.createGroup(record.layout);
+		auto& group = node->as_group();
+
+		for (auto& child: record.children) {
+			group.insertChild(restoreNode(host, child));
+		}
+
+		group.ephemeral = record.ephemeral;
+		group.expand_focused = record.expand_focused;
+		group.group_focused = record.group_focused;
+		group.locked = record.locked;
+		group.containment = record.containment;
+		group.focused_child = record.focused_child < 0 ? nullptr : group.children[record.focused_child].get();
+	}
+
+	node->size_ratio = record.size_ratio;
+	return node;
+}
+
+class Replay {
+public:
+	std::map<int64_t, std::unique_ptr<Hy3FakeHost>> workspaces;
+	int64_t focused_workspace = -1;
+	// targets whose geometry after the first pass differs from the snapshot
+	size_t snapshot_mismatches = 0;
+
+	void restore(const Hy3RecordSnapshot& snapshot) {
+		this->focused_workspace = snapshot.focused_workspace;
+
+		for (auto& workspace: snapshot.workspaces) {
+			auto& host = this->host(workspace.id);
+			host.area = workspace.area;
+			host.offsets = workspace.offsets;
+			host.params = workspace.params;
+
+			auto& root = *host.root;
+			for (auto& child: workspace.root.children) {
+				root.insertChild(restoreNode(host, child));
+			}
+
+			root.group_focused = workspace.root.group_focused;
+			root.focused_child =
+			    workspace.root.focused_child < 0 ? nullptr : root.children[workspace.root.focused_child].get();
+
+			host.recalcGeometry();
+			host.flushGeometry();
+			this->compareGeometry(host, workspace.root);
+		}
+	}
+
+	// Replay a single event, returns false if it is not supported.
+	bool replay(const Hy3RecordEntry& entry) {
+		switch (entry.event) {
+		case Hy3RecordEvent::NewTarget:
+			this->focused_workspace = entry.workspace;
+			this->host(entry.workspace).insert(entry.window);
+			return true;
+		case Hy3RecordEvent::MovedTarget: {
+			if (auto* target = this->findTarget(entry.window)) this->removeTarget(*target);
+
+			std::optional<Hy3Point> focal_point;
+			if (entry.point) focal_point = Hy3Point {entry.point->first, entry.point->second};
+
+			this->host(entry.workspace).insert(entry.window, focal_point);
+			return true;
+		}
+		case Hy3RecordEvent::RemoveTarget:
+			if (auto* target = this->findTarget(entry.window)) this->removeTarget(*target);
+			return true;
+		case Hy3RecordEvent::ResizeTarget:
+			if (auto* target = this->findTarget(entry.window)) this->resize(*target, entry);
+			return true;
+		case Hy3RecordEvent::FocusChange:
+			if (auto* target = this->findTarget(entry.window)) {
+				this->focused_workspace = entry.workspace;
+				target->markFocused();
+			}
+			return true;
+		case Hy3RecordEvent::Dispatch: return this->dispatch(entry.command);
+		case Hy3RecordEvent::Count: break;
+		}
+
+		return false;
+	}
+
+	// Run the geometry passes scheduled by the last event, as the next frame would.
+	void frame() {
+		for (auto& [id, host]: this->workspaces) host->flushGeometry();
+	}
+
+private:
+	Hy3FakeHost& host(int64_t workspace) {
+		auto& host = this->workspaces[workspace];
+
+		if (!host) {
+			host = std::make_unique<Hy3FakeHost>();
+			// workspaces created during the recording are assumed to match the first one
+			if (this->workspaces.size() > 1) {
+				auto& first = *this->workspaces.begin()->second;
+				host->area = first.area;
+				host->offsets = first.offsets;
+				host->params = first.params;
+			}
+		}
+
+		return *host;
+	}
+
+	Hy3FakeTarget* findTarget(uint64_t window) {
+		if (window == 0) return nullptr;
+
+		for (auto& [id, host]: this->workspaces) {
+			if (auto* target = host->find(window)) return target;
+		}
+
+		return nullptr;
+	}
+
+	void removeTarget(Hy3FakeTarget& target) {
+		auto& host = static_cast<Hy3FakeHost&>(*target.host());
+		host.remove(target);
+	}
+
+	Hy3Node* focusedNode() {
+		auto it = this->workspaces.find(this->focused_workspace);
+		return it == this->workspaces.end() ? nullptr : it->second->focusedNode();
+	}
+
+	// see Hy3Layout::resizeTarget
+	void resize(Hy3FakeTarget& target, const Hy3RecordEntry& entry) {
+		auto& host = static_cast<Hy3FakeHost&>(*target.host());
+		host.flushGeometry();
+
+		Hy3Point delta {
+		    static_cast<double>(entry.point ? entry.point->first : 0),
+		    static_cast<double>(entry.point ? entry.point->second : 0),
+		};
+
+		resizeNode(target, delta, host.area, static_cast<Hy3ResizeCorner>(entry.corner), true);
+	}
+
+	// Replay a dispatcher call recorded as "name, args".
+	bool dispatch(std::string_view command) {
+		auto args = splitArgs(command);
+		if (args.empty()) return false;
+		auto name = args[0];
+
+		if (name == "batch") {
+			// "batch, name args; hy3:name, args; ..."
+			auto list = trim(command.substr(std::min(command.find(',') + 1, command.size())));
+			auto supported = true;
+
+			while (!list.empty()) {
+				auto end = list.find(';');
+				auto entry = trim(list.substr(0, end));
+				if (!entry.empty()) supported &= this->dispatch(normalizeCommand(entry));
+				if (end == std::string_view::npos) break;
+				list.remove_prefix(end + 1);
+			}
+
+			return supported;
+		}
+
+		auto* node = this->focusedNode();
+		if (node == nullptr) return true;
+		auto arg = args.size() > 1 ? args[1] : std::string_view();
+
+		if (name == "movefocus" || name == "movewindow") {
+			auto direction = parseDirection(arg);
+			if (!direction) return true;
+
+			auto shift = name == "movewindow";
+			auto result = shiftOrGetFocus(
+			    *node,
+			    *direction,
+			    shift,
+			    hasArg(args, "once"),
+			    hasArg(args, "visible"),
+			    CollapsePolicy::EmptySplits
+			);
+
+			if (result.shifted) node->markFocused();
+			else if (result.focus != nullptr) result.focus->markFocused();
+			return true;
+		}
+
+		if (name == "makegroup") {
+			node = &node->getPlacementActor();
+			if (node->is_root()) return true;
+
+			if (arg == "opposite") makeOppositeGroupOn(*node, GroupEphemeralityOption::Standard);
+			else if (arg == "h") makeGroupOn(*node, Hy3GroupLayout::SplitH, GroupEphemeralityOption::Standard);
+			else if (arg == "v") makeGroupOn(*node, Hy3GroupLayout::SplitV, GroupEphemeralityOption::Standard);
+			else if (arg == "tab") makeGroupOn(*node, Hy3GroupLayout::Tabbed, GroupEphemeralityOption::Standard);
+			return true;
+		}
+
+		if (name == "changefocus") {
+			if (arg == "raise" && !node->parent->is_root()) {
+				node->parent->markFocused();
+			} else if (arg == "lower" && node->is_group() && node->as_group().focused_child != nullptr) {
+				node->as_group().focused_child->markFocused();
+			}
+
+			return true;
+		}
+
+		if (name == "killactive") {
+			if (node->is_target()) this->removeTarget(static_cast<Hy3FakeTarget&>(node->as_target_node()));
+			return true;
+		}
+
+		return false;
+	}
+
+	void compareGeometry(Hy3FakeHost& host, const Hy3RecordNode& record) {
+		if (!record.group) {
+			auto* target = host.find(record.window);
+			auto& box = record.box;
+
+			// boxes are recorded as f32
+			if (target == nullptr || std::abs(target->visualBox.x - box.x) > 1
+			    || std::abs(target->visualBox.y - box.y) > 1 || std::abs(target->visualBox.w - box.w) > 1
+			    || std::abs(target->visualBox.h - box.h) > 1)
+				this->snapshot_mismatches++;
+
+			return;
+		}
+
+		for (auto& child: record.children) {
+			this->compareGeometry(host, child);
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	g_logSink = logToStderr;
+
+	bool print_events = false;
+	const char* path = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg == "--events") print_events = true;
+		else if (path == nullptr && !arg.starts_with("--")) path = argv[i];
+		else {
+			std::fprintf(stderr, "usage: hy3-replay [--events] <recording>\n");
+			return 2;
+		}
+	}
+
+	if (path == nullptr) {
+		std::fprintf(stderr, "usage: hy3-replay [--events] <recording>\n");
+		return 2;
+	}
+
+	std::vector<Hy3RecordEntry> entries;
+	Hy3RecordSnapshot snapshot;
+
+	if (auto error = Hy3Recorder::read(path, entries, &snapshot)) {
+		std::fprintf(stderr, "%s\n", error->c_str());
+		return 1;
+	}
+
+	Replay replay;
+	replay.restore(snapshot);
+
+	// Events are written when they finish, so nested events come before the event they
+	// are nested in. They are held back until it is known whether that event is replayed.
+	std::vector<const Hy3RecordEntry*> nested;
+	std::vector<Hy3RecordEntry> replayed;
+	size_t skipped = 0;
+
+	auto run = [&](const Hy3RecordEntry& entry) {
+		auto start = std::chrono::steady_clock::now();
+		auto supported = replay.replay(entry);
+		replay.frame();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		if (!supported) {
+			skipped++;
+			return false;
+		}
+
+		auto& result = replayed.emplace_back(entry);
+		result.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+		if (print_events) {
+			std::printf(
+			    "%zu %s window %llu recorded %llu ns replayed %llu ns\n",
+			    replayed.size() + skipped - 1,
+			    Hy3Recorder::eventName(entry.event),
+			    static_cast<unsigned long long>(entry.window),
+			    static_cast<unsigned long long>(entry.duration_ns),
+			    static_cast<unsigned long long>(result.duration_ns)
+			);
+		}
+
+		return true;
+	};
+
+	for (auto& entry: entries) {
+		if (entry.depth != 0) {
+			nested.push_back(&entry);
+			continue;
+		}
+
+		if (!run(entry)) {
+			for (auto* inner: nested) run(*inner);
+		} else {
+			skipped += nested.size();
+		}
+
+		nested.clear();
+	}
+
+	// events of a dispatcher still running when recording stopped
+	for (auto* inner: nested) run(*inner);
+
+	std::printf(
+	    "{\"events\":%zu,\"replayed\":%zu,\"skipped\":%zu,\"snapshot_mismatches\":%zu,\"latency\":%s}\n",
+	    entries.size(),
+	    replayed.size(),
+	    skipped,
+	    replay.snapshot_mismatches,
+	    Hy3Recorder::summaryJson(replayed).c_str()
+	);
+
+	return 0;
+}